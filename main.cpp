@@ -1,969 +1,6665 @@
-﻿#include <iostream>
-#include <fstream>
-#include <string>
-#include <vector>
-
-enum class GrammarType {
-	Type0,
-	Type1,
-	Type2,
-	Type3,
-	TypeNULL
-};
-
-struct Grammar {
-	std::vector<std::string> nonTerminals,
-							 terminals;
-
-	std::vector<std::pair<std::string, std::string>> productionRules;
-
-	std::string startingPoint;
-}gram1, gram2;
-
-void PrintGrammar(Grammar grammar) {
-	std::cout << "\n\nNonterminals: ";
-	for (std::vector<std::string>::iterator it = grammar.nonTerminals.begin(); it != grammar.nonTerminals.end(); it++) {
-		std::cout << "\"" << *it << "\" ";
-	}
-
-	std::cout << "\nTerminals: ";
-	for (std::vector<std::string>::iterator it = grammar.terminals.begin(); it != grammar.terminals.end(); it++) {
-		std::cout << "\"" << *it << "\" ";
-	}
-
-	std::cout << "\nStarting point: " << grammar.startingPoint;
-
-	std::cout << "\nProduction rules: ";
-	for (std::vector<std::pair<std::string, std::string>>::iterator it = grammar.productionRules.begin(); it != grammar.productionRules.end(); it++) {
-		std::cout << "\"" << (*it).first << " -> " << (*it).second << "\" ";
-	}
-}
-
-bool IsType3(std::pair<std::string, std::string> format, std::vector<std::pair<std::string, std::string>> rules) {
-	if (format.first.length() > 1) { // if there is more than one character on the left, it cannot be type 3 (or type 2)
-		return false;
-	}
-
-	if (format.second.find('N') == std::string::npos) { // if we can't find any non-terminal on the right, then we only have terminals
-		if (format.second.compare("E") == 0) { // if the right side consists of only the empty word...
-			// check if the left side non-terminal exists in any other rule on the right-side
-			for (std::vector<std::pair<std::string, std::string>>::iterator itRule = rules.begin(); itRule != rules.end(); itRule++) {
-				if ((*itRule).second.find(format.first)) { // if we do find it, it is not of type 3
-					return false;
-				}
-			}
-		}
-		
-		return true; // otherwise, we're good
-	}
-
-	if (format.second.find_first_of('N') != format.second.find_last_of('N')) { // we have more than one nonterminal on the right hand side
-		return false;
-	}
-
-	if (format.second.find_first_of('T') == 0 && format.second.find_last_of('T') == format.second.length() - 1) {
-		return false; // if the first character is a terminal, and so is the last one, then we have terminals on both the left and right sides of a non-terminal
-	}
-
-	// check if we have both A -> Bp and A -> pB
-	return true; // we passed all checks, our rule is of type N -> n * T N or N -> N T * n, where n >= 0
-}
-
-bool IsType2(std::pair<std::string, std::string> format) {
-	return (format.first.length() == 1); // we need exactly one character on the left, if we have more, the rule is at most of type 1.
-	// this is because the right-side can consist of any combination of non-terminals and terminals
-}
-
-bool IsType1(std::pair<std::string, std::string> format, std::pair<std::string, std::string> rule, std::vector<std::pair<std::string, std::string>> rules, std::string startingPoint) {
-	if (format.first.length() > format.second.length()) { // if the left hand side has more non-terminals/terminals than the right side, it's type 0
-		return false;
-	}
-
-	if (format.second.compare("E") == 0) { // if the right side consists of only the empty word
-		if (rule.first.compare(startingPoint) != 0) { // check if the starting point can't be found in our rule on the left side
-			return false; // this means that the non-terminal on the left side is not a starting point and therefore this can't be type 1
-		} // otherwise...
-		// check if the starting point appears in any other rule
-		for (std::vector<std::pair<std::string, std::string>>::iterator itRule = rules.begin(); itRule != rules.end(); itRule++) {
-			if ((*itRule).second.find(startingPoint)) {
-				return false; // and say it is type 0 if it does
-			}
-		}
-	}
-
-	if (format.first.length() > 1) { // this means we have some context we need to care for
-		int nonTerminalOffset = 0; // determine where our non-terminal is
-		for (std::string::iterator itFirst = rule.first.begin(); itFirst != rule.first.end(); itFirst++, nonTerminalOffset++) {
-			if (rule.second.find(*itFirst) == std::string::npos) { // if we can't find the non-terminal on the right side, that is the non-terminal we replace
-				break;
-			}
-			else if (rule.first.find_first_of(*itFirst) != rule.first.find_last_of(*itFirst)) {
-				// this means we have two different instances of the same non-terminal
-				
-				int occurences = 0;
-				for (std::string::iterator itStr = rule.first.begin(); itStr != rule.first.end(); itStr++) {
-					if (*itFirst == *itStr) {
-						occurences++;
-					}
-				}
-
-				for (std::string::iterator itStr = rule.second.begin(); itStr != rule.second.end(); itStr++) {
-					if (*itFirst == *itStr) {
-						occurences--;
-					}
-				}
-
-				if (occurences != 0) { // this means one of the non-terminals is the one we're looking for
-					// check prefix for every non-terminal of that kind, the first prefix to be different is our left context
-					size_t offset = rule.first.find(*itFirst), prevOffset = 0; 
-					bool found = false;
-					while (offset != std::string::npos) {
-						if (rule.first.compare(prevOffset, offset, rule.second, prevOffset, offset) != 0) {
-							found = true;
-							nonTerminalOffset = prevOffset;
-						}
-
-						prevOffset = offset;
-						offset = rule.first.find(*itFirst, offset + 1);
-					}
-
-					if (!found) {
-						nonTerminalOffset = rule.first.size() - 1;
-					}
-				}
-				break;
-			}
-		}
-
-		std::string leftContext, rightContext;
-
-		for (std::string::iterator itFirst = rule.first.begin(); itFirst != rule.first.end(); itFirst++) {
-			if (itFirst - rule.first.begin() < nonTerminalOffset) {
-				leftContext.push_back(*itFirst); // this is what's on the left of our non-terminal on the left side of our rule
-			}
-			else if (itFirst - rule.first.begin() > nonTerminalOffset){
-				rightContext.push_back(*itFirst); // this is what's on the right of our non-terminal on the left side of our rule
-			}
-		}
-
-		if (leftContext.length() > 0) { // if we have anything on the left of our non-terminal on the left side of the rule
-			if (rule.second.compare(0, nonTerminalOffset, leftContext) != 0) { // and if the same thing can't be found on the right side of our rule
-				return false; // then it's type 0
-			}
-		}
-
-		if (rightContext.length() > 0) { // if we have anything on the right of our non-terminal on the left side of the rule
-			if (rule.second.compare(nonTerminalOffset + 1, std::string::npos, rightContext) != 0) { // and if the same thing can't be found on the right side of our rule
-				return false; // then it's type 0
-			}
-		}
-	}
-
-	return true; // we passed all checks, this is a type 1 rule.
-}
-
-GrammarType FindGrammarType(Grammar gram) {
-	GrammarType type = gram.productionRules.empty() ? GrammarType::TypeNULL : GrammarType::Type3;
-	
-	for (std::vector<std::pair<std::string, std::string>>::iterator itRule = gram.productionRules.begin(); itRule != gram.productionRules.end() && type != GrammarType::Type0; itRule++) {
-		std::pair<std::string, std::string> format; // N - non-terminal, T - terminal, E - empty word
-
-		for (std::string::iterator itFirst = (*itRule).first.begin(); itFirst != (*itRule).first.end(); itFirst++) {
-			std::string currStr; currStr.push_back(*itFirst);
-			
-			if (currStr.compare("|") == 0) {
-				format.first = 'E';
-				continue;
-			}
-
-			bool found = false;
-			do {
-				for (std::vector<std::string>::iterator itNT = gram.nonTerminals.begin(); itNT != gram.nonTerminals.end() && !found; itNT++) {
-					if ((*itNT).compare(currStr) == 0) {
-						format.first.push_back('N');
-						found = true;
-					}
-				}
-
-				for (std::vector<std::string>::iterator itT = gram.terminals.begin(); itT != gram.terminals.end() && !found; itT++) {
-					if ((*itT).compare(currStr) == 0) {
-						format.first.push_back('T');
-						found = true;
-					}
-				}
-
-				if (!found) {
-					itFirst++;
-					currStr.push_back(*itFirst);
-				}
-			} while (!found);
-		}
-
-		for (std::string::iterator itSecond = (*itRule).second.begin(); itSecond != (*itRule).second.end(); itSecond++) {
-			std::string currStr; currStr.push_back(*itSecond);
-
-			if (currStr.compare("|") == 0) {
-				format.second = 'E';
-				continue;
-			}
-
-			bool found = false;
-			do {
-				for (std::vector<std::string>::iterator itNT = gram.nonTerminals.begin(); itNT != gram.nonTerminals.end() && !found; itNT++) {
-					if ((*itNT).compare(currStr) == 0) {
-						format.second.push_back('N');
-						found = true;
-					}
-				}
-
-				for (std::vector<std::string>::iterator itT = gram.terminals.begin(); itT != gram.terminals.end() && !found; itT++) {
-					if ((*itT).compare(currStr) == 0) {
-						format.second.push_back('T');
-						found = true;
-					}
-				}
-
-				if (!found) {
-					itSecond++;
-					currStr.push_back(*itSecond);
-				}
-			} while (!found);
-		}
-
-		if (type == GrammarType::Type3) {
-			if (!IsType3(format, gram.productionRules)) {
-				type = GrammarType::Type2;
-			}
-		}
-
-		if (type == GrammarType::Type2) {
-			if (!IsType2(format)) {
-				type = GrammarType::Type1;
-			}
-		}
-
-		if (type == GrammarType::Type1) {
-			if (!IsType1(format, *itRule, gram.productionRules, gram.startingPoint)) {
-				type = GrammarType::Type0;
-			}
-		}
-	}
-
-	return type;
-}
-
-// Functions used across all closure properties
-
-void AddTerminals(Grammar& newGram, Grammar& otherGram) {
-	for (std::vector<std::string>::iterator itO = otherGram.terminals.begin(); itO != otherGram.terminals.end(); itO++) {
-		bool alreadyFound = false;
-		for (std::vector<std::string>::iterator itN = newGram.terminals.begin(); itN != newGram.terminals.end() && !alreadyFound; itN++) {
-			if (*itN == *itO) {
-				alreadyFound = true;
-			}
-		}
-
-		if (!alreadyFound) {
-			newGram.terminals.push_back(*itO); // we just add all of them without worry
-		}
-	}
-}
-
-// Union functions
-void AddNonTerminalsUnion(Grammar& newGram, Grammar& otherGram, std::vector<std::string> terminals) { 
-	// adds the non-terminals and the starting point, making the necessary adjustments if needed
-	if (newGram.nonTerminals.empty()) { // if we don't have any other non-terminals
-		for (std::vector<std::string>::iterator itO = otherGram.nonTerminals.begin(); itO != otherGram.nonTerminals.end(); itO++) {
-			bool alreadyExists = false;
-			do {
-				alreadyExists = false;
-				std::string foundString;
-				for (std::vector<std::string>::iterator itT = terminals.begin(); itT != terminals.end() && !alreadyExists; itT++) {
-					if ((*itT).compare(*itO) == 0) { // if the terminal already exists in the grammar we are trying to make
-						alreadyExists = true;
-						foundString = *itO;
-
-						(*itO).push_back('\'');
-					}
-				}
-
-				if (alreadyExists) {
-					for (std::vector<std::pair<std::string, std::string>>::iterator itPair = otherGram.productionRules.begin(); itPair != otherGram.productionRules.end(); itPair++) {
-						const size_t offsetFirst = (*itPair).first.find(foundString);
-						if (offsetFirst != std::string::npos) {
-							std::string newStr;
-							for (size_t i = 0; i <= offsetFirst; i++) {
-								newStr.push_back((*itPair).first[i]);
-							}
-							newStr.push_back('\'');
-							for (size_t i = offsetFirst + 1; i < (*itPair).first.size(); i++) {
-								newStr.push_back((*itPair).first[i]);
-							}
-							(*itPair).first = newStr;
-						}
-
-						const size_t offsetSecond = (*itPair).second.find(foundString);
-						if (offsetSecond != std::string::npos) {
-							std::string newStr;
-							for (size_t i = 0; i <= offsetSecond; i++) {
-								newStr.push_back((*itPair).second[i]);
-							}
-							newStr.push_back('\'');
-							for (size_t i = offsetSecond + 1; i < (*itPair).second.size(); i++) {
-								newStr.push_back((*itPair).second[i]);
-							}
-							(*itPair).second = newStr;
-						}
-					}
-				}
-			} while (alreadyExists);
-			newGram.nonTerminals.push_back(*itO);
-		}
-
-		newGram.startingPoint.push_back('S'); // we make a new starting point
-
-		bool alreadyExists;
-		do {
-			alreadyExists = false;
-			for (std::vector<std::string>::iterator itN = newGram.nonTerminals.begin(); itN != newGram.nonTerminals.end() && !alreadyExists; itN++) {
-				if ((*itN).compare(newGram.startingPoint) == 0) { // we check if our new starting point already exists in our nonTerminals
-					alreadyExists = true;
-				}
-			}
-
-			if (alreadyExists) { // if it does already exist
-				newGram.startingPoint.push_back('\''); // then add another ' to hopefully differentiate it from the others
-			}
-		} while (alreadyExists);
-
-		newGram.nonTerminals.push_back(newGram.startingPoint); // finally, we add the starting point to our list of non-terminals
-	}
-	else {
-		for (std::vector<std::string>::iterator itO = otherGram.nonTerminals.begin(); itO != otherGram.nonTerminals.end(); itO++) {
-			bool alreadyExists = false;
-			do {
-				alreadyExists = false;
-				std::string foundString;
-				for (std::vector<std::string>::iterator itN = newGram.nonTerminals.begin(); itN != newGram.nonTerminals.end() && !alreadyExists; itN++) {
-					if ((*itN).compare(*itO) == 0) { // if the non-terminal already exists in the grammar we are trying to make
-						alreadyExists = true;
-						foundString = *itO;
-
-						(*itO).push_back('\'');
-					}
-				}
-
-				if (!alreadyExists) {
-					for (std::vector<std::string>::iterator itT = newGram.terminals.begin(); itT != newGram.terminals.end() && !alreadyExists; itT++) {
-						if ((*itT).compare(*itO) == 0) { // if the terminal already exists in the grammar we are trying to make
-							alreadyExists = true;
-							foundString = *itO;
-
-							(*itO).push_back('\'');
-						}
-					}
-
-					if (foundString.compare(otherGram.startingPoint) == 0) {
-						otherGram.startingPoint = *itO;
-					}
-				}
-
-				if (alreadyExists) {
-					for (std::vector<std::pair<std::string, std::string>>::iterator itPair = otherGram.productionRules.begin(); itPair != otherGram.productionRules.end(); itPair++) {
-						const size_t offsetFirst = (*itPair).first.find(foundString);
-						if (offsetFirst != std::string::npos) {
-							std::string newStr;
-							for (size_t i = 0; i <= offsetFirst; i++) {
-								newStr.push_back((*itPair).first[i]);
-							}
-							newStr.push_back('\'');
-							for (size_t i = offsetFirst + 1; i < (*itPair).first.size(); i++) {
-								newStr.push_back((*itPair).first[i]);
-							}
-							(*itPair).first = newStr;
-						}
-
-						const size_t offsetSecond = (*itPair).second.find(foundString);
-						if (offsetSecond != std::string::npos) {
-							std::string newStr;
-							for (size_t i = 0; i <= offsetSecond; i++) {
-								newStr.push_back((*itPair).second[i]);
-							}
-							newStr.push_back('\'');
-							for (size_t i = offsetSecond + 1; i < (*itPair).second.size(); i++) {
-								newStr.push_back((*itPair).second[i]);
-							}
-							(*itPair).second = newStr;
-						}
-					}
-
-					if (foundString.compare(otherGram.startingPoint) == 0) {
-						otherGram.startingPoint = *itO;
-					}
-				}
-			} while (alreadyExists);
-			newGram.nonTerminals.push_back(*itO);
-		}
-	}
-}
-
-void AddProductionRulesUnion(Grammar& newGram, Grammar& otherGram) {
-	for (std::vector<std::pair<std::string, std::string>>::iterator itO = otherGram.productionRules.begin(); itO != otherGram.productionRules.end(); itO++) {
-		newGram.productionRules.push_back(*itO); // we just add all of them without worry
-	}
-
-	newGram.productionRules.push_back(std::pair<std::string, std::string>(newGram.startingPoint, otherGram.startingPoint));
-}
-
-Grammar CreateGrammarFromUnion(Grammar gram1, Grammar gram2) {
-	Grammar newGram;
-
-	AddNonTerminalsUnion(newGram, gram1, gram2.terminals);
-	AddNonTerminalsUnion(newGram, gram2, gram2.terminals);
-
-	AddTerminals(newGram, gram1);
-	AddTerminals(newGram, gram2);
-
-	AddProductionRulesUnion(newGram, gram1);
-	AddProductionRulesUnion(newGram, gram2);
-
-	return newGram;
-}
-
-// Product functions
-void AddNonTerminalsProduct3(Grammar& newGram, Grammar& otherGram, std::vector<std::string> terminals) { 
-	// adds the non-terminals for grammars of type 3 closed under product
-	if (newGram.nonTerminals.empty()) { // if we don't have any other non-terminals
-		for (std::vector<std::string>::iterator itO = otherGram.nonTerminals.begin(); itO != otherGram.nonTerminals.end(); itO++) {
-			bool alreadyExists = false;
-			do {
-				alreadyExists = false;
-				std::string foundString;
-				for (std::vector<std::string>::iterator itT = terminals.begin(); itT != terminals.end() && !alreadyExists; itT++) {
-					if ((*itT).compare(*itO) == 0) { // if the terminal already exists in the grammar we are trying to make
-						alreadyExists = true;
-						foundString = *itO;
-
-						(*itO).push_back('\'');
-					}
-				}
-
-				if (alreadyExists) {
-					for (std::vector<std::pair<std::string, std::string>>::iterator itPair = otherGram.productionRules.begin(); itPair != otherGram.productionRules.end(); itPair++) {
-						const size_t offsetFirst = (*itPair).first.find(foundString);
-						if (offsetFirst != std::string::npos) {
-							std::string newStr;
-							for (size_t i = 0; i <= offsetFirst; i++) {
-								newStr.push_back((*itPair).first[i]);
-							}
-							newStr.push_back('\'');
-							for (size_t i = offsetFirst + 1; i < (*itPair).first.size(); i++) {
-								newStr.push_back((*itPair).first[i]);
-							}
-							(*itPair).first = newStr;
-						}
-
-						const size_t offsetSecond = (*itPair).second.find(foundString);
-						if (offsetSecond != std::string::npos) {
-							std::string newStr;
-							for (size_t i = 0; i <= offsetSecond; i++) {
-								newStr.push_back((*itPair).second[i]);
-							}
-							newStr.push_back('\'');
-							for (size_t i = offsetSecond + 1; i < (*itPair).second.size(); i++) {
-								newStr.push_back((*itPair).second[i]);
-							}
-							(*itPair).second = newStr;
-						}
-					}
-
-					if (foundString.compare(gram1.startingPoint) == 0) {
-						gram1.startingPoint = *itO;
-					}
-				}
-			} while (alreadyExists);
-			newGram.nonTerminals.push_back(*itO);
-		}
-
-		newGram.startingPoint = gram1.startingPoint;
-	}
-	else {
-		for (std::vector<std::string>::iterator itO = otherGram.nonTerminals.begin(); itO != otherGram.nonTerminals.end(); itO++) {
-			bool alreadyExists = false;
-			do {
-				alreadyExists = false;
-				std::string foundString;
-				for (std::vector<std::string>::iterator itN = newGram.nonTerminals.begin(); itN != newGram.nonTerminals.end() && !alreadyExists; itN++) {
-					if ((*itN).compare(*itO) == 0) { // if the non-terminal already exists in the grammar we are trying to make
-						alreadyExists = true;
-						foundString = *itO;
-
-						(*itO).push_back('\'');
-					}
-				}
-
-				if (!alreadyExists) {
-					for (std::vector<std::string>::iterator itT = newGram.terminals.begin(); itT != newGram.terminals.end() && !alreadyExists; itT++) {
-						if ((*itT).compare(*itO) == 0) { // if the terminal already exists in the grammar we are trying to make
-							alreadyExists = true;
-							foundString = *itO;
-
-							(*itO).push_back('\'');
-						}
-					}
-
-					if (foundString.compare(gram2.startingPoint) == 0) {
-						gram2.startingPoint = *itO;
-					}
-				}
-
-				if (alreadyExists) {
-					for (std::vector<std::pair<std::string, std::string>>::iterator itPair = otherGram.productionRules.begin(); itPair != otherGram.productionRules.end(); itPair++) {
-						const size_t offsetFirst = (*itPair).first.find(foundString);
-						if (offsetFirst != std::string::npos) {
-							std::string newStr;
-							for (size_t i = 0; i <= offsetFirst; i++) {
-								newStr.push_back((*itPair).first[i]);
-							}
-							newStr.push_back('\'');
-							for (size_t i = offsetFirst + 1; i < (*itPair).first.size(); i++) {
-								newStr.push_back((*itPair).first[i]);
-							}
-							(*itPair).first = newStr;
-						}
-
-						const size_t offsetSecond = (*itPair).second.find(foundString);
-						if (offsetSecond != std::string::npos) {
-							std::string newStr;
-							for (size_t i = 0; i <= offsetSecond; i++) {
-								newStr.push_back((*itPair).second[i]);
-							}
-							newStr.push_back('\'');
-							for (size_t i = offsetSecond + 1; i < (*itPair).second.size(); i++) {
-								newStr.push_back((*itPair).second[i]);
-							}
-							(*itPair).second = newStr;
-						}
-					}
-
-					if (foundString.compare(gram2.startingPoint) == 0) {
-						gram2.startingPoint = *itO;
-					}
-				}
-			} while (alreadyExists);
-			newGram.nonTerminals.push_back(*itO);
-		}
-	}
-}
-
-void AddProductionRulesProduct012(Grammar& newGram, Grammar& gram1, Grammar& gram2) {
-	for (std::vector<std::pair<std::string, std::string>>::iterator itO = gram1.productionRules.begin(); itO != gram1.productionRules.end(); itO++) {
-		newGram.productionRules.push_back(*itO); // we just add all of them without worry
-	}
-	for (std::vector<std::pair<std::string, std::string>>::iterator itO = gram2.productionRules.begin(); itO != gram2.productionRules.end(); itO++) {
-		newGram.productionRules.push_back(*itO); // we just add all of them without worry
-	}
-
-	newGram.productionRules.push_back(std::pair<std::string, std::string>(newGram.startingPoint, (gram1.startingPoint + gram2.startingPoint)));
-}
-
-void AddProductionRulesProduct3(Grammar& newGram, Grammar& gram1, Grammar& gram2) {
-	for (std::vector<std::pair<std::string, std::string>>::iterator itO = gram1.productionRules.begin(); itO != gram1.productionRules.end(); itO++) {
-		bool found = false;
-		for (std::vector<std::string>::iterator itNT = gram1.nonTerminals.begin(); itNT != gram1.nonTerminals.end(); itNT++) {
-			if (((*itO).second).find(*itNT) != std::string::npos) {
-				found = true;
-				break;
-			}
-		}
-
-		if (!found) {
-			(*itO).second.append(gram2.startingPoint);
-		}
-
-		newGram.productionRules.push_back(*itO);
-	}
-
-	for (std::vector<std::pair<std::string, std::string>>::iterator itO = gram2.productionRules.begin(); itO != gram2.productionRules.end(); itO++) {
-		newGram.productionRules.push_back(*itO); // we just add all of them without worry
-	}
-}
-
-Grammar CreateGrammarFromProduct(Grammar gram1, Grammar gram2) {
-	Grammar newGram;
-
-	GrammarType gram1Type = FindGrammarType(gram1);
-	if (gram1Type == GrammarType::Type3 && gram1Type == FindGrammarType(gram2)) {
-		AddNonTerminalsProduct3(newGram, gram1, gram2.terminals);
-		AddNonTerminalsProduct3(newGram, gram2, gram2.terminals);
-
-		AddTerminals(newGram, gram1);
-		AddTerminals(newGram, gram2);
-
-		AddProductionRulesProduct3(newGram, gram1, gram2);
-	}
-	else {
-		AddNonTerminalsUnion(newGram, gram1, gram2.terminals);
-		AddNonTerminalsUnion(newGram, gram2, gram2.terminals);
-
-		AddTerminals(newGram, gram1);
-		AddTerminals(newGram, gram2);
-
-		AddProductionRulesProduct012(newGram, gram1, gram2);
-	}
-
-	return newGram;
-}
-
-// Closure functions
-void AddNonTerminalsClosure01(Grammar& newGram, Grammar& otherGram) {
-	for (std::vector<std::string>::iterator itO = otherGram.nonTerminals.begin(); itO != otherGram.nonTerminals.end(); itO++) {
-		newGram.nonTerminals.push_back(*itO); // we just add all of them without worry
-	}
-
-	newGram.startingPoint.push_back('S'); // we make a new starting point
-
-	bool alreadyExists;
-	do {
-		alreadyExists = false;
-		for (std::vector<std::string>::iterator itN = newGram.nonTerminals.begin(); itN != newGram.nonTerminals.end() && !alreadyExists; itN++) {
-			if ((*itN).compare(newGram.startingPoint) == 0) { // we check if our new starting point already exists in our nonTerminals
-				alreadyExists = true;
-			}
-		}
-
-		if (alreadyExists) { // if it does already exist
-			newGram.startingPoint.push_back('\''); // then add another ' to hopefully differentiate it from the others
-		}
-	} while (alreadyExists);
-
-	newGram.nonTerminals.push_back(newGram.startingPoint); // finally, we add the starting point to our list of non-terminals
-
-	std::string newNT = "X"; // we add a new non-terminal
-
-	do {
-		alreadyExists = false;
-		for (std::vector<std::string>::iterator itN = newGram.nonTerminals.begin(); itN != newGram.nonTerminals.end() && !alreadyExists; itN++) {
-			if ((*itN).compare(newNT) == 0) { // we check if our new non-terminal already exists in our nonTerminals
-				alreadyExists = true;
-			}
-		}
-
-		if (alreadyExists) { // if it does already exist
-			newNT.push_back('\''); // then add another ' to hopefully differentiate it from the others
-		}
-	} while (alreadyExists);
-
-	newGram.nonTerminals.push_back(newNT); // finally, we add the non-terminal to our list of non-terminals
-}
-
-void AddProductionRulesClosure01(Grammar& newGram, Grammar& otherGram) {
-	for (std::vector<std::pair<std::string, std::string>>::iterator itO = otherGram.productionRules.begin(); itO != otherGram.productionRules.end(); itO++) {
-		newGram.productionRules.push_back(*itO); // we just add all of them without worry
-	}
-
-	std::string newNT = newGram.nonTerminals[newGram.nonTerminals.size() - 1];
-
-	newGram.productionRules.push_back(std::pair<std::string, std::string>(newGram.startingPoint, otherGram.startingPoint));
-	newGram.productionRules.push_back(std::pair<std::string, std::string>(newGram.startingPoint, "|"));
-	newGram.productionRules.push_back(std::pair<std::string, std::string>(newGram.startingPoint, (newNT + otherGram.startingPoint)));
-
-	for (std::vector<std::string>::iterator itO = otherGram.terminals.begin(); itO != otherGram.terminals.end(); itO++) {
-		newGram.productionRules.push_back(std::pair<std::string, std::string>((newNT + (*itO)), (otherGram.startingPoint + *itO)));
-		newGram.productionRules.push_back(std::pair<std::string, std::string>((newNT + (*itO)), (newNT + otherGram.startingPoint + *itO)));
-	}
-}
-
-void AddNonTerminalsClosure23(Grammar& newGram, Grammar& otherGram) {
-	for (std::vector<std::string>::iterator itO = otherGram.nonTerminals.begin(); itO != otherGram.nonTerminals.end(); itO++) {
-		newGram.nonTerminals.push_back(*itO); // we just add all of them without worry
-	}
-
-	newGram.startingPoint.push_back('S'); // we make a new starting point
-
-	bool alreadyExists;
-	do {
-		alreadyExists = false;
-		for (std::vector<std::string>::iterator itN = newGram.nonTerminals.begin(); itN != newGram.nonTerminals.end() && !alreadyExists; itN++) {
-			if ((*itN).compare(newGram.startingPoint) == 0) { // we check if our new starting point already exists in our nonTerminals
-				alreadyExists = true;
-			}
-		}
-
-		if (alreadyExists) { // if it does already exist
-			newGram.startingPoint.push_back('\''); // then add another ' to hopefully differentiate it from the others
-		}
-	} while (alreadyExists);
-
-	newGram.nonTerminals.push_back(newGram.startingPoint); // finally, we add the starting point to our list of non-terminals
-}
-
-void AddProductionRulesClosure2(Grammar& newGram, Grammar& otherGram) {
-	for (std::vector<std::pair<std::string, std::string>>::iterator itO = otherGram.productionRules.begin(); itO != otherGram.productionRules.end(); itO++) {
-		newGram.productionRules.push_back(*itO); // we just add all of them without worry
-	}
-
-	newGram.productionRules.push_back(std::pair<std::string, std::string>(newGram.startingPoint, (newGram.startingPoint + otherGram.startingPoint)));
-	newGram.productionRules.push_back(std::pair<std::string, std::string>(newGram.startingPoint, "|"));
-}
-
-void AddProductionRulesClosure3(Grammar& newGram, Grammar& otherGram) {
-	for (std::vector<std::pair<std::string, std::string>>::iterator itO = otherGram.productionRules.begin(); itO != otherGram.productionRules.end(); itO++) {
-		newGram.productionRules.push_back(*itO); // we just add all of them without worry
-	}
-
-	for (std::vector<std::pair<std::string, std::string>>::iterator itO = otherGram.productionRules.begin(); itO != otherGram.productionRules.end(); itO++) {
-		bool found = false;
-		for (std::vector<std::string>::iterator itNT = otherGram.nonTerminals.begin(); itNT != otherGram.nonTerminals.end(); itNT++) {
-			if (((*itO).second).find(*itNT) != std::string::npos) {
-				found = true;
-				break;
-			}
-		}
-
-		if (!found) {
-			(*itO).second.append(otherGram.startingPoint);
-			newGram.productionRules.push_back(*itO);
-		}
-	}
-
-	newGram.productionRules.push_back(std::pair<std::string, std::string>(newGram.startingPoint, otherGram.startingPoint));
-	newGram.productionRules.push_back(std::pair<std::string, std::string>(newGram.startingPoint, "|"));
-}
-
-Grammar CreateGrammarFromClosure(Grammar gram1) {
-	Grammar newGram;
-	
-	switch (FindGrammarType(gram1)) {
-		case GrammarType::Type0:
-		case GrammarType::Type1: {
-			AddNonTerminalsClosure01(newGram, gram1);
-
-			AddTerminals(newGram, gram1);
-
-			AddProductionRulesClosure01(newGram, gram1);
-			break;
-		}
-		case GrammarType::Type2: {
-			AddNonTerminalsClosure23(newGram, gram1);
-
-			AddTerminals(newGram, gram1);
-
-			AddProductionRulesClosure2(newGram, gram1);
-			break;
-		}
-		case GrammarType::Type3: {
-			AddNonTerminalsClosure23(newGram, gram1);
-
-			AddTerminals(newGram, gram1);
-
-			AddProductionRulesClosure3(newGram, gram1);
-			break;
-		}
-	}
-
-	return newGram;
-}
-
-// Menu/Reading functions
-
-Grammar ReadGrammar() {
-	Grammar newGram;
-	int num = -1;
-	do {
-		std::cout << "How many non-terminals do you want?\n"; std::cin >> num;
-	} while (num < 0);
-
-	for (int i = 0; i < num; i++) {
-		std::string str1;
-		std::cout << "\nRead non-terminal number " << i + 1 << ": "; std::cin >> str1;
-
-		newGram.nonTerminals.push_back(str1);
-	}
-
-	num = -1;
-	do {
-		std::cout << "\nHow many terminals do you want?\n"; std::cin >> num;
-	} while (num < 0);
-
-	for (int i = 0; i < num; i++) {
-		std::string str1;
-		std::cout << "\nRead terminal number " << i + 1 << ": "; std::cin >> str1;
-
-		newGram.terminals.push_back(str1);
-	}
-
-	if (newGram.nonTerminals.size() > 0) {
-		std::cout << "\nRead the number of the non-terminal you want to be the starting point.\n";
-		int count = 1;
-		for (std::vector<std::string>::iterator itNT = newGram.nonTerminals.begin(); itNT != newGram.nonTerminals.end(); itNT++, count++) {
-			std::string nT = *itNT;
-			std::cout << count << ". " << nT << '\n';
-		}
-
-		int num = -1;
-		do {
-			std::cin >> num;
-		} while (num < 1 && num > newGram.nonTerminals.size());
-
-		newGram.startingPoint = newGram.nonTerminals[num - 1];
-	}
-
-	num = -1;
-	do {
-		std::cout << "\nHow many production rules do you want?\n"; std::cin >> num;
-	} while (num < 0);
-
-	for (int i = 0; i < num; i++) {
-		std::string str1, str2;
-		std::cout << "\n\nRead left-hand side of production rule number " << i + 1 << ": "; std::cin >> str1;
-		std::cout << "\nRead right-hand side of production rule number " << i + 1 << ": "; std::cin >> str2;
-		newGram.productionRules.push_back(std::pair<std::string, std::string>(str1, str2));
-	}
-
-	return newGram;
-}
-
-bool RunMenu()
-{
-	int caseNum = 0; Grammar selectedGram;
-	do {
-		std::cout << "\n\n\nInput your choice.";
-		std::cout << "\n1.Read first grammar.";
-		std::cout << "\n2.Read second grammar.";
-		std::cout << "\n3.Select and print said grammar.";
-		std::cout << "\n4.Select and show the type of said grammar.";
-		std::cout << "\n5.Devise a new grammar under the union of the first and second grammars.";
-		std::cout << "\n6.Devise a new grammar under the product of the first and second grammars.";
-		std::cout << "\n7.Select and devise a new grammar under the Kleene Closure of selected grammar.";
-		std::cin >> caseNum;
-		system("cls");
-	} while (caseNum < 1 || caseNum > 7);
-
-	if (caseNum == 3 || caseNum == 4 || caseNum == 7) {
-		int gramNum = -1;
-		do {
-			std::cout << "\n\n\nInput your choice.";
-			std::cout << "\n1.Select first grammar.";
-			std::cout << "\n2.Select second grammar.";
-			std::cin >> gramNum;
-			system("cls");
-		} while (gramNum != 1 && gramNum != 2);
-
-		selectedGram = (gramNum == 1) ? gram1 : gram2;
-	}
-
-	switch (caseNum) {
-		case 1: {
-			gram1 = ReadGrammar();
-			break;
-		}
-		case 2: {
-			gram2 = ReadGrammar();
-			break;
-		}
-		case 3: {
-			PrintGrammar(selectedGram);
-			break;
-		}
-		case 4: {
-			switch (FindGrammarType(selectedGram)) {
-				case GrammarType::Type0: {
-					std::cout << "\nSelected grammar is of type 0.";
-					break;
-				}
-				case GrammarType::Type1: {
-					std::cout << "\nSelected grammar is of type 1.";
-					break;
-				}
-				case GrammarType::Type2: {
-					std::cout << "\nSelected grammar is of type 2.";
-					break;
-				}
-				case GrammarType::Type3: {
-					std::cout << "\nSelected grammar is of type 3.";
-					break;
-				}
-			}
-			break;
-		}
-		case 5: {
-			Grammar resultingGrammar = CreateGrammarFromUnion(gram1, gram2);
-			PrintGrammar(resultingGrammar);
-			break;
-		}
-		case 6: {
-			Grammar resultingGrammar = CreateGrammarFromProduct(gram1, gram2);
-			PrintGrammar(resultingGrammar);
-			break;
-		}
-		case 7: {
-			Grammar resultingGrammar = CreateGrammarFromClosure(selectedGram);
-			PrintGrammar(resultingGrammar);
-			break;
-		}
-	}
-
-	char ans = '\0';
-	do {
-		std::cout << "\n\nDo you wish to keep running this program?"; std::cin >> ans;
-	} while (!strchr("yYnN", ans));
-
-	return (strchr("yY", ans));
-}
-
-int main() {
-	gram1.nonTerminals.push_back("A");
-	gram1.nonTerminals.push_back("B");
-	gram1.nonTerminals.push_back("C");
-	gram1.nonTerminals.push_back("D");
-	gram1.nonTerminals.push_back("E");
-	gram1.nonTerminals.push_back("F");
-	gram1.nonTerminals.push_back("S");
-	gram1.terminals.push_back("a");
-	gram1.terminals.push_back("b");
-	gram1.terminals.push_back("c");
-	gram1.terminals.push_back("d");
-	gram1.terminals.push_back("0");
-	gram1.terminals.push_back("1");
-	gram1.terminals.push_back("5");
-	gram1.startingPoint = "S";
-	gram1.productionRules.push_back(std::pair<std::string, std::string>("S", "aA"));
-	gram1.productionRules.push_back(std::pair<std::string, std::string>("S", "bB"));
-	gram1.productionRules.push_back(std::pair<std::string, std::string>("S", "cC"));
-	gram1.productionRules.push_back(std::pair<std::string, std::string>("S", "dD"));
-	gram1.productionRules.push_back(std::pair<std::string, std::string>("A", "1"));
-	gram1.productionRules.push_back(std::pair<std::string, std::string>("B", "5"));
-	gram1.productionRules.push_back(std::pair<std::string, std::string>("C", "5E"));
-	gram1.productionRules.push_back(std::pair<std::string, std::string>("C", "1F"));
-	gram1.productionRules.push_back(std::pair<std::string, std::string>("D", "10"));
-	gram1.productionRules.push_back(std::pair<std::string, std::string>("E", "1"));
-	gram1.productionRules.push_back(std::pair<std::string, std::string>("F", "5"));
-
-	gram2.nonTerminals.push_back("X");
-	gram2.nonTerminals.push_back("Y");
-	gram2.nonTerminals.push_back("Z");
-	gram2.nonTerminals.push_back("W");
-	gram2.nonTerminals.push_back("R");
-	gram2.nonTerminals.push_back("S");
-	gram2.terminals.push_back("x");
-	gram2.terminals.push_back("y");
-	gram2.terminals.push_back("w");
-	gram2.terminals.push_back("z");
-	gram2.terminals.push_back("0");
-	gram2.terminals.push_back("1");
-	gram2.terminals.push_back("5");
-	gram2.startingPoint = "S";
-	gram2.productionRules.push_back(std::pair<std::string, std::string>("S", "xX"));
-	gram2.productionRules.push_back(std::pair<std::string, std::string>("S", "yY"));
-	gram2.productionRules.push_back(std::pair<std::string, std::string>("S", "zZ"));
-	gram2.productionRules.push_back(std::pair<std::string, std::string>("S", "wW"));
-	gram2.productionRules.push_back(std::pair<std::string, std::string>("Y", "1R"));
-	gram2.productionRules.push_back(std::pair<std::string, std::string>("R", "1"));
-	gram2.productionRules.push_back(std::pair<std::string, std::string>("X", "1"));
-	gram2.productionRules.push_back(std::pair<std::string, std::string>("Z", "5"));
-	gram2.productionRules.push_back(std::pair<std::string, std::string>("W", "10"));
-
-	while (RunMenu());
-	return 0;
+﻿#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <string_view>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <random>
+#include <cmath>
+#include <chrono>
+#include <filesystem>
+#include <algorithm>
+#include <new>
+#include <cstdlib>
+#ifdef EXPRESSION_CHECKS
+#include <sstream>
+#endif
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+// Allocation counting, compile with NO_ALLOCATION_COUNTER to leave the global operator new alone
+
+std::atomic<size_t> allocationCount(0),
+					allocatedBytes(0);
+
+#ifndef NO_ALLOCATION_COUNTER
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete" // GCC doesn't know free() is right for memory from our own operator new
+#endif
+
+void* operator new(size_t size) {
+	allocationCount.fetch_add(1, std::memory_order_relaxed);
+	allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+	if (void* memory = malloc(size ? size : 1)) {
+		return memory;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept {
+	free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+	free(memory);
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif
+
+// Instrumentation, compile with NO_INSTRUMENTATION to leave every timer and counter out of the hot paths
+
+enum class StatPhase : uint32_t {
+	LoadGrammar,
+	FindGrammarType,
+	RightSideIndex,
+	AddTerminals,
+	AddNonTerminals,
+	AddMappedRules,
+	Union,
+	Product,
+	Closure,
+	ProductAutomaton,
+	Count
+};
+
+enum class StatCounter : uint32_t {
+	SymbolLookups,
+	RuleRewrites,
+	FreshNameAttempts,
+	Count
+};
+
+const char* const StatPhaseNames[] = { "load", "classify", "right side index", "terminals", "non-terminals", "mapped rules", "union", "product", "closure", "product automaton" };
+const char* const StatCounterNames[] = { "symbol_lookups", "rule_rewrites", "fresh_name_attempts" };
+
+struct PhaseStats { // a phase that runs inside another one is counted in both
+	std::atomic<uint64_t> calls,
+						  nanoseconds,
+						  allocations,
+						  allocatedBytes;
+};
+
+struct Stats { // only gathered once enabled through --stats, so a run without it pays a relaxed load for every timer and counter
+	std::atomic<bool> enabled;
+	bool json;
+	PhaseStats phases[(size_t)StatPhase::Count];
+	std::atomic<uint64_t> counters[(size_t)StatCounter::Count];
+}stats;
+
+struct ScopedPhase { // adds the time and the allocations of its scope to a phase
+	PhaseStats* phase; // nullptr while the stats are off
+	size_t allocationsBefore = 0,
+		   bytesBefore = 0;
+	std::chrono::steady_clock::time_point start;
+
+	explicit ScopedPhase(StatPhase which) : phase(stats.enabled.load(std::memory_order_relaxed) ? &stats.phases[(size_t)which] : nullptr) {
+		if (phase) {
+			allocationsBefore = allocationCount;
+			bytesBefore = allocatedBytes;
+			start = std::chrono::steady_clock::now();
+		}
+	}
+
+	~ScopedPhase() {
+		if (phase) {
+			phase->nanoseconds.fetch_add((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count(), std::memory_order_relaxed);
+			phase->calls.fetch_add(1, std::memory_order_relaxed);
+			phase->allocations.fetch_add(allocationCount - allocationsBefore, std::memory_order_relaxed);
+			phase->allocatedBytes.fetch_add(allocatedBytes - bytesBefore, std::memory_order_relaxed);
+		}
+	}
+};
+
+inline void CountStat(StatCounter counter, uint64_t amount) {
+	if (stats.enabled.load(std::memory_order_relaxed)) {
+		stats.counters[(size_t)counter].fetch_add(amount, std::memory_order_relaxed);
+	}
+}
+
+#ifndef NO_INSTRUMENTATION
+#define STAT_PHASE(phase) ScopedPhase scopedPhase(phase)
+#define STAT_COUNT(counter, amount) CountStat(counter, amount)
+#else
+#define STAT_PHASE(phase)
+#define STAT_COUNT(counter, amount)
+#endif
+
+void ReportStats() {
+	// writes what was gathered since the last report to stderr and starts over, nothing if no phase ran
+	bool any = false;
+	for (size_t i = 0; i < (size_t)StatPhase::Count; i++) {
+		any = any || stats.phases[i].calls != 0;
+	}
+	if (!any) {
+		return;
+	}
+
+	if (stats.json) {
+		std::cerr << "{\"phases\":[";
+	}
+	bool first = true;
+	for (size_t i = 0; i < (size_t)StatPhase::Count; i++) {
+		const PhaseStats& phase = stats.phases[i];
+		if (phase.calls == 0) {
+			continue;
+		}
+
+		const double milliseconds = phase.nanoseconds / 1e6;
+		if (stats.json) {
+			std::cerr << (first ? "" : ",") << "{\"phase\":\"" << StatPhaseNames[i] << "\",\"calls\":" << phase.calls << ",\"ms\":" << milliseconds
+					  << ",\"allocations\":" << phase.allocations << ",\"allocated_kib\":" << phase.allocatedBytes / 1024 << "}";
+		}
+		else {
+			std::cerr << "stats: " << StatPhaseNames[i] << ": " << phase.calls << " calls, " << milliseconds << " ms, "
+					  << phase.allocations << " allocations, " << phase.allocatedBytes / 1024 << " KiB allocated\n";
+		}
+		first = false;
+	}
+
+	if (stats.json) {
+		std::cerr << "]";
+	}
+	else {
+		std::cerr << "stats:";
+	}
+	for (size_t i = 0; i < (size_t)StatCounter::Count; i++) {
+		if (stats.json) {
+			std::cerr << ",\"" << StatCounterNames[i] << "\":" << stats.counters[i];
+		}
+		else {
+			std::cerr << ' ' << stats.counters[i] << ' ' << StatCounterNames[i] << ((i + 1 < (size_t)StatCounter::Count) ? "," : "\n");
+		}
+	}
+	if (stats.json) {
+		std::cerr << "}\n";
+	}
+
+	for (size_t i = 0; i < (size_t)StatPhase::Count; i++) {
+		stats.phases[i].calls = 0;
+		stats.phases[i].nanoseconds = 0;
+		stats.phases[i].allocations = 0;
+		stats.phases[i].allocatedBytes = 0;
+	}
+	for (size_t i = 0; i < (size_t)StatCounter::Count; i++) {
+		stats.counters[i] = 0;
+	}
+}
+
+
+enum class GrammarType {
+	Type0,
+	Type1,
+	Type2,
+	Type3,
+	TypeNULL
+};
+
+// Every terminal and non-terminal is interned into a 32-bit id. The top bit tags terminals,
+// the remaining bits index into Grammar::terminals or Grammar::nonTerminals, so both alphabets stay dense.
+typedef uint32_t Symbol;
+
+const Symbol TerminalTag = 0x80000000u;
+const Symbol NoSymbol = 0xFFFFFFFFu;
+
+inline bool IsTerminal(Symbol symbol) {
+	return (symbol & TerminalTag) != 0;
+}
+
+inline uint32_t SymbolIndex(Symbol symbol) {
+	return symbol & ~TerminalTag;
+}
+
+struct RuleView { // non-owning view of one production rule, pointing into Grammar::ruleSymbols
+	const Symbol* left;
+	uint32_t leftLength;
+	const Symbol* right;
+	uint32_t rightLength; // a right side of length 0 is the empty word
+};
+
+const size_t LargeArenaAllocation = 16 * 1024; // anything this big gets a block of its own
+
+struct Arena { // bump allocator, small things are handed out from big blocks and only given back all at once
+	std::vector<std::unique_ptr<char[]>> blocks,
+										 largeBlocks; // given back one by one, so a growing vector doesn't leave its old buffers behind
+	char* next = nullptr;
+	size_t left = 0,
+		   nextBlockSize = 4096;
+
+	void* Allocate(size_t size, size_t alignment) {
+		if (size >= LargeArenaAllocation) {
+			largeBlocks.emplace_back(new char[size]);
+			return largeBlocks.back().get();
+		}
+
+		size_t padding = (alignment - (uintptr_t)next % alignment) % alignment;
+		if (padding + size > left) {
+			const size_t blockSize = std::max(nextBlockSize, size + alignment);
+			blocks.emplace_back(new char[blockSize]);
+			next = blocks.back().get();
+			left = blockSize;
+			nextBlockSize = std::min<size_t>(2 * nextBlockSize, 4 * LargeArenaAllocation);
+			padding = (alignment - (uintptr_t)next % alignment) % alignment;
+		}
+
+		void* memory = next + padding;
+		next += padding + size;
+		left -= padding + size;
+		return memory;
+	}
+
+	void Deallocate(void* memory, size_t size) {
+		if (size < LargeArenaAllocation) { // small things stay until the arena goes
+			return;
+		}
+
+		for (size_t i = largeBlocks.size(); i-- > 0;) { // the newest blocks are the likeliest to go first
+			if (largeBlocks[i].get() == memory) {
+				largeBlocks[i].swap(largeBlocks.back());
+				largeBlocks.pop_back();
+				return;
+			}
+		}
+	}
+
+	std::string_view Store(std::string_view str) {
+		char* memory = (char*)Allocate(str.size(), 1);
+		memcpy(memory, str.data(), str.size());
+		return std::string_view(memory, str.size());
+	}
+};
+
+template <typename T>
+struct ArenaAllocator { // lets the standard containers live in an arena
+	typedef T value_type;
+	typedef std::true_type propagate_on_container_move_assignment;
+	typedef std::true_type propagate_on_container_swap;
+
+	std::shared_ptr<Arena> arena; // shared, so the arena stays around for as long as some container still points into it
+
+	ArenaAllocator(const std::shared_ptr<Arena>& arena) : arena(arena) {}
+	template <typename U>
+	ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+	T* allocate(size_t count) {
+		return (T*)arena->Allocate(count * sizeof(T), alignof(T));
+	}
+
+	void deallocate(T* memory, size_t count) {
+		arena->Deallocate(memory, count * sizeof(T));
+	}
+
+	template <typename U>
+	bool operator==(const ArenaAllocator<U>& other) const {
+		return arena == other.arena;
+	}
+
+	template <typename U>
+	bool operator!=(const ArenaAllocator<U>& other) const {
+		return arena != other.arena;
+	}
+};
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+const uint64_t NoTrieEdge = ~(uint64_t)0;
+
+struct SymbolTrie { // prefix tree over the names of all symbols, used to look them up and to split the sides of a rule
+	ArenaVector<Symbol> nodeSymbols; // the symbol whose name ends at each node, node 0 is the root
+	ArenaVector<uint64_t> edgeKeys; // open addressing over (node << 8 | character), NoTrieEdge marks a free slot
+	ArenaVector<uint32_t> edgeChildren; // the child node of every used slot, every node but the root has exactly one edge
+
+	SymbolTrie(const std::shared_ptr<Arena>& arena) : nodeSymbols(1, NoSymbol, arena), edgeKeys(arena), edgeChildren(arena) {}
+};
+
+struct RightSideCounts { // how often every non-terminal appears on a right side, cheap to keep up to date as rules change
+	std::vector<uint32_t> nonTerminals;
+};
+
+struct IncrementalClassification { // kept up to date by AddProductionRule and RemoveProductionRule once enabled
+	bool enabled = false;
+	std::vector<uint8_t> ruleFlags; // what every rule passes on its own, see ClassifyRule
+	RightSideCounts rightSide;
+	std::vector<uint32_t> emptyWordRules; // for every non-terminal, how many A -> | rules it has
+
+	// rules that fail a check on their own, A -> | rules aside
+	size_t notType3 = 0,
+		   notType2 = 0,
+		   notType1 = 0;
+	size_t emptyWordCount = 0,
+		   usedEmptyWordRules = 0; // A -> | rules whose A is on some right side
+};
+
+struct MappedFile; // a read-only mapping of a whole file, see the binary file functions
+
+struct Grammar {
+	// the names, the symbol table and the rules all live in the grammar's own arena, so a grammar is freed at once
+	// and a copy builds everything again in a fresh arena; a moved-from grammar must not be used any more
+	std::shared_ptr<Arena> arena;
+
+	ArenaVector<std::string_view> nonTerminals,
+								  terminals; // the names are only needed when reading and printing
+
+	SymbolTrie symbolTrie; // name -> id, shared by both alphabets
+
+	// both sides of every production rule are stored back to back: rule i has its left side in
+	// [ruleOffsets[2i], ruleOffsets[2i + 1]) and its right side in [ruleOffsets[2i + 1], ruleOffsets[2i + 2])
+	ArenaVector<Symbol> ruleSymbols;
+	ArenaVector<uint32_t> ruleOffsets;
+
+	// a grammar loaded from a binary file reads its rules in place from the mapped file, which is kept alive here,
+	// until a rule is added and they get copied into ruleSymbols and ruleOffsets
+	std::shared_ptr<const MappedFile> mappedFile;
+	const Symbol* mappedSymbols = nullptr;
+	const uint32_t* mappedOffsets = nullptr;
+	size_t mappedRuleCount = 0;
+
+	IncrementalClassification classification;
+
+	Symbol startingPoint = NoSymbol;
+
+	Grammar();
+	Grammar(const Grammar& other);
+	Grammar(Grammar&& other) = default;
+	Grammar& operator=(const Grammar& other);
+	Grammar& operator=(Grammar&& other) = default;
+}gram1, gram2;
+
+// Symbol table functions
+
+inline uint64_t TrieEdgeKey(uint32_t node, char character) {
+	return ((uint64_t)node << 8) | (unsigned char)character;
+}
+
+size_t TrieEdgeSlot(const SymbolTrie& trie, uint64_t key) {
+	// linear probing from the hashed key, until we find the key or a free slot
+	const size_t mask = trie.edgeKeys.size() - 1;
+	size_t slot = (size_t)((key * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+	while (trie.edgeKeys[slot] != key && trie.edgeKeys[slot] != NoTrieEdge) {
+		slot = (slot + 1) & mask;
+	}
+
+	return slot;
+}
+
+uint32_t FindTrieChild(const SymbolTrie& trie, uint32_t node, char character) {
+	// 0 if there is no such edge, the root is nobody's child
+	if (trie.edgeKeys.empty()) {
+		return 0;
+	}
+
+	const size_t slot = TrieEdgeSlot(trie, TrieEdgeKey(node, character));
+	return (trie.edgeKeys[slot] == NoTrieEdge) ? 0 : trie.edgeChildren[slot];
+}
+
+void ReserveTrieEdges(SymbolTrie& trie, size_t edgeCount) {
+	// keeps the table at most half full, the old table is left to the arena when it has to grow
+	size_t slotCount = std::max<size_t>(trie.edgeKeys.size(), 16);
+	while (slotCount < 2 * edgeCount) {
+		slotCount *= 2;
+	}
+	if (slotCount == trie.edgeKeys.size()) {
+		return;
+	}
+
+	ArenaVector<uint64_t> oldKeys(trie.edgeKeys.get_allocator());
+	ArenaVector<uint32_t> oldChildren(trie.edgeChildren.get_allocator());
+	oldKeys.swap(trie.edgeKeys);
+	oldChildren.swap(trie.edgeChildren);
+	trie.edgeKeys.assign(slotCount, NoTrieEdge);
+	trie.edgeChildren.assign(slotCount, 0);
+	for (size_t i = 0; i < oldKeys.size(); i++) {
+		if (oldKeys[i] != NoTrieEdge) {
+			const size_t slot = TrieEdgeSlot(trie, oldKeys[i]);
+			trie.edgeKeys[slot] = oldKeys[i];
+			trie.edgeChildren[slot] = oldChildren[i];
+		}
+	}
+}
+
+void InsertIntoTrie(SymbolTrie& trie, std::string_view name, Symbol symbol) {
+	ReserveTrieEdges(trie, trie.nodeSymbols.size() - 1 + name.size()); // enough for a whole new branch
+	uint32_t node = 0;
+	for (std::string_view::const_iterator it = name.begin(); it != name.end(); it++) {
+		const uint64_t key = TrieEdgeKey(node, *it);
+		const size_t slot = TrieEdgeSlot(trie, key);
+		if (trie.edgeKeys[slot] == NoTrieEdge) { // we didn't have this prefix yet, so the new edge points to a new node
+			trie.edgeKeys[slot] = key;
+			trie.edgeChildren[slot] = (uint32_t)trie.nodeSymbols.size();
+			trie.nodeSymbols.push_back(NoSymbol);
+		}
+		node = trie.edgeChildren[slot];
+	}
+
+	trie.nodeSymbols[node] = symbol;
+}
+
+Symbol FindSymbol(const Grammar& gram, std::string_view name) {
+	// exact match through the trie, so callers holding a view into some buffer don't need to build a std::string
+	STAT_COUNT(StatCounter::SymbolLookups, 1);
+	const SymbolTrie& trie = gram.symbolTrie;
+	uint32_t node = 0;
+	for (std::string_view::const_iterator it = name.begin(); it != name.end(); it++) {
+		node = FindTrieChild(trie, node, *it);
+		if (node == 0) {
+			return NoSymbol;
+		}
+	}
+
+	return trie.nodeSymbols[node];
+}
+
+Symbol AddNonTerminal(Grammar& gram, std::string_view name) {
+	Symbol symbol = FindSymbol(gram, name);
+	if (symbol == NoSymbol) { // we only intern names we haven't seen yet
+		symbol = (Symbol)gram.nonTerminals.size();
+		gram.nonTerminals.push_back(gram.arena->Store(name));
+		InsertIntoTrie(gram.symbolTrie, name, symbol);
+	}
+
+	return symbol;
+}
+
+Symbol AddTerminal(Grammar& gram, std::string_view name) {
+	Symbol symbol = FindSymbol(gram, name);
+	if (symbol == NoSymbol) {
+		symbol = (Symbol)gram.terminals.size() | TerminalTag;
+		gram.terminals.push_back(gram.arena->Store(name));
+		InsertIntoTrie(gram.symbolTrie, name, symbol);
+	}
+
+	return symbol;
+}
+
+size_t SymbolCount(const Grammar& gram) {
+	return gram.nonTerminals.size() + gram.terminals.size();
+}
+
+std::string_view SymbolName(const Grammar& gram, Symbol symbol) {
+	return IsTerminal(symbol) ? gram.terminals[SymbolIndex(symbol)] : gram.nonTerminals[SymbolIndex(symbol)];
+}
+
+Grammar::Grammar()
+	: arena(std::make_shared<Arena>()), nonTerminals(arena), terminals(arena), symbolTrie(arena), ruleSymbols(arena), ruleOffsets(1, 0, arena) {}
+
+Grammar::Grammar(const Grammar& other) : Grammar() {
+	// the names go into our own arena, the rules are copied with their final size known
+	for (size_t i = 0; i < other.nonTerminals.size(); i++) {
+		AddNonTerminal(*this, other.nonTerminals[i]);
+	}
+	for (size_t i = 0; i < other.terminals.size(); i++) {
+		AddTerminal(*this, other.terminals[i]);
+	}
+
+	ruleSymbols.assign(other.ruleSymbols.begin(), other.ruleSymbols.end());
+	ruleOffsets.assign(other.ruleOffsets.begin(), other.ruleOffsets.end());
+	mappedFile = other.mappedFile;
+	mappedSymbols = other.mappedSymbols;
+	mappedOffsets = other.mappedOffsets;
+	mappedRuleCount = other.mappedRuleCount;
+	classification = other.classification;
+	startingPoint = other.startingPoint;
+}
+
+Grammar& Grammar::operator=(const Grammar& other) {
+	if (this != &other) {
+		*this = Grammar(other);
+	}
+
+	return *this;
+}
+
+// Production rule functions
+
+size_t RuleCount(const Grammar& gram) {
+	return gram.mappedFile ? gram.mappedRuleCount : (gram.ruleOffsets.size() - 1) / 2;
+}
+
+const Symbol* RuleSymbolData(const Grammar& gram) {
+	return gram.mappedFile ? gram.mappedSymbols : gram.ruleSymbols.data();
+}
+
+const uint32_t* RuleOffsetData(const Grammar& gram) {
+	return gram.mappedFile ? gram.mappedOffsets : gram.ruleOffsets.data();
+}
+
+size_t RuleSymbolCount(const Grammar& gram) {
+	return RuleOffsetData(gram)[2 * RuleCount(gram)];
+}
+
+RuleView GetRule(const Grammar& gram, size_t index) {
+	const uint32_t* offsets = RuleOffsetData(gram) + 2 * index;
+	const Symbol* symbols = RuleSymbolData(gram);
+
+	RuleView rule;
+	rule.left = symbols + offsets[0];
+	rule.leftLength = offsets[1] - offsets[0];
+	rule.right = symbols + offsets[1];
+	rule.rightLength = offsets[2] - offsets[1];
+	return rule;
+}
+
+void OwnRules(Grammar& gram) {
+	// copies rules that are still read from a mapped file into the grammar, so they can be changed
+	if (!gram.mappedFile) {
+		return;
+	}
+
+	gram.ruleSymbols.assign(gram.mappedSymbols, gram.mappedSymbols + RuleSymbolCount(gram));
+	gram.ruleOffsets.assign(gram.mappedOffsets, gram.mappedOffsets + 2 * gram.mappedRuleCount + 1);
+
+	gram.mappedFile.reset();
+	gram.mappedSymbols = nullptr;
+	gram.mappedOffsets = nullptr;
+	gram.mappedRuleCount = 0;
+}
+
+void AddRuleToClassification(Grammar& gram, size_t ruleIndex);
+void CountRule(Grammar& gram, size_t ruleIndex, bool adding);
+
+void AddProductionRule(Grammar& gram, const Symbol* left, size_t leftLength, const Symbol* right, size_t rightLength) {
+	OwnRules(gram);
+	gram.ruleSymbols.insert(gram.ruleSymbols.end(), left, left + leftLength);
+	gram.ruleOffsets.push_back((uint32_t)gram.ruleSymbols.size());
+	gram.ruleSymbols.insert(gram.ruleSymbols.end(), right, right + rightLength);
+	gram.ruleOffsets.push_back((uint32_t)gram.ruleSymbols.size());
+
+	AddRuleToClassification(gram, RuleCount(gram) - 1);
+}
+
+void RemoveProductionRule(Grammar& gram, size_t index) {
+	// the classification only updates its counts, the rules after the removed one are moved down in place
+	OwnRules(gram);
+	if (gram.classification.enabled) {
+		CountRule(gram, index, false);
+		gram.classification.ruleFlags.erase(gram.classification.ruleFlags.begin() + index);
+	}
+
+	const uint32_t start = gram.ruleOffsets[2 * index],
+				   length = gram.ruleOffsets[2 * index + 2] - start;
+	gram.ruleSymbols.erase(gram.ruleSymbols.begin() + start, gram.ruleSymbols.begin() + start + length);
+	gram.ruleOffsets.erase(gram.ruleOffsets.begin() + 2 * index + 1, gram.ruleOffsets.begin() + 2 * index + 3);
+	for (size_t i = 2 * index + 1; i < gram.ruleOffsets.size(); i++) {
+		gram.ruleOffsets[i] -= length;
+	}
+}
+
+void AddProductionRule(Grammar& gram, const std::vector<Symbol>& left, const std::vector<Symbol>& right) {
+	AddProductionRule(gram, left.data(), left.size(), right.data(), right.size());
+}
+
+void AddProductionRule(Grammar& gram, std::initializer_list<Symbol> left, std::initializer_list<Symbol> right) {
+	// for the rules the builders make up themselves, without allocating a vector for each side
+	AddProductionRule(gram, left.begin(), left.size(), right.begin(), right.size());
+}
+
+void ReserveGrammar(Grammar& gram, size_t symbolCount, size_t ruleCount, size_t ruleSymbolCount) {
+	// the builders know how big their result will be, so everything is allocated once at its final size
+	OwnRules(gram);
+	ReserveTrieEdges(gram.symbolTrie, symbolCount); // at least one node for every name
+	gram.ruleOffsets.reserve(2 * ruleCount + 1);
+	gram.ruleSymbols.reserve(ruleSymbolCount);
+}
+
+bool SplitIntoSymbols(const Grammar& gram, std::string_view side, std::vector<Symbol>& symbols, size_t& errorOffset) {
+	// splits one side of a rule in a single pass, always taking the longest symbol name that matches, "|" being the empty word
+	const SymbolTrie& trie = gram.symbolTrie;
+	for (size_t offset = 0; offset < side.size();) {
+		if (side[offset] == '|') { // the empty word doesn't add anything to the rule
+			offset++;
+			continue;
+		}
+
+		Symbol symbol = NoSymbol;
+		size_t length = 0;
+		uint32_t node = 0;
+		for (size_t i = offset; i < side.size(); i++) { // walk down the trie for as long as we are on a prefix of some name
+			node = FindTrieChild(trie, node, side[i]);
+			if (node == 0) {
+				break;
+			}
+
+			if (trie.nodeSymbols[node] != NoSymbol) { // remember the longest name we went through
+				symbol = trie.nodeSymbols[node];
+				length = i - offset + 1;
+			}
+		}
+
+		if (symbol == NoSymbol) { // what's left of the string doesn't start with any symbol we know
+			errorOffset = offset;
+			return false;
+		}
+
+		symbols.push_back(symbol);
+		offset += length;
+	}
+
+	return true;
+}
+
+bool ParseProductionRule(Grammar& gram, const std::string& left, const std::string& right, std::string* error = nullptr) {
+	std::vector<Symbol> leftSymbols, rightSymbols;
+	size_t errorOffset = 0;
+	if (!SplitIntoSymbols(gram, left, leftSymbols, errorOffset)) {
+		if (error) {
+			*error = "no symbol starts at \"" + left.substr(errorOffset) + "\" in \"" + left + "\"";
+		}
+		return false;
+	}
+
+	if (!SplitIntoSymbols(gram, right, rightSymbols, errorOffset)) {
+		if (error) {
+			*error = "no symbol starts at \"" + right.substr(errorOffset) + "\" in \"" + right + "\"";
+		}
+		return false;
+	}
+
+	AddProductionRule(gram, leftSymbols, rightSymbols);
+	return true;
+}
+
+void PrintRuleSide(const Grammar& gram, const Symbol* symbols, uint32_t length) {
+	if (length == 0) {
+		std::cout << "|";
+	}
+
+	for (uint32_t i = 0; i < length; i++) {
+		std::cout << SymbolName(gram, symbols[i]);
+	}
+}
+
+void PrintGrammar(const Grammar& grammar) {
+	std::cout << "\n\nNonterminals: ";
+	for (ArenaVector<std::string_view>::const_iterator it = grammar.nonTerminals.begin(); it != grammar.nonTerminals.end(); it++) {
+		std::cout << "\"" << *it << "\" ";
+	}
+
+	std::cout << "\nTerminals: ";
+	for (ArenaVector<std::string_view>::const_iterator it = grammar.terminals.begin(); it != grammar.terminals.end(); it++) {
+		std::cout << "\"" << *it << "\" ";
+	}
+
+	std::cout << "\nStarting point: ";
+	if (grammar.startingPoint != NoSymbol) {
+		std::cout << SymbolName(grammar, grammar.startingPoint);
+	}
+
+	std::cout << "\nProduction rules: ";
+	for (size_t i = 0; i < RuleCount(grammar); i++) {
+		RuleView rule = GetRule(grammar, i);
+		std::cout << "\"";
+		PrintRuleSide(grammar, rule.left, rule.leftLength);
+		std::cout << " -> ";
+		PrintRuleSide(grammar, rule.right, rule.rightLength);
+		std::cout << "\" ";
+	}
+}
+
+// Classification functions
+
+struct RightSideIndex { // for every symbol, the rules that use it on their right side
+	// occurrences of non-terminal n are rules[nonTerminalStarts[n] .. nonTerminalStarts[n + 1]), the same goes for terminals
+	std::vector<uint32_t> nonTerminalStarts,
+						  terminalStarts;
+	std::vector<uint32_t> rules;
+};
+
+RightSideIndex BuildRightSideIndex(const Grammar& gram) {
+	STAT_PHASE(StatPhase::RightSideIndex);
+	RightSideIndex index;
+	index.nonTerminalStarts.assign(gram.nonTerminals.size() + 1, 0);
+	index.terminalStarts.assign(gram.terminals.size() + 1, 0);
+
+	// first count the occurrences of every symbol, then turn the counts into start offsets
+	for (size_t i = 0; i < RuleCount(gram); i++) {
+		RuleView rule = GetRule(gram, i);
+		for (uint32_t j = 0; j < rule.rightLength; j++) {
+			std::vector<uint32_t>& starts = IsTerminal(rule.right[j]) ? index.terminalStarts : index.nonTerminalStarts;
+			starts[SymbolIndex(rule.right[j]) + 1]++;
+		}
+	}
+
+	for (size_t i = 1; i < index.nonTerminalStarts.size(); i++) {
+		index.nonTerminalStarts[i] += index.nonTerminalStarts[i - 1];
+	}
+	for (size_t i = 1; i < index.terminalStarts.size(); i++) {
+		index.terminalStarts[i] += index.terminalStarts[i - 1];
+	}
+
+	// terminal occurrences are stored after all the non-terminal ones
+	const uint32_t terminalBase = index.nonTerminalStarts.back();
+	index.rules.resize(terminalBase + index.terminalStarts.back());
+
+	std::vector<uint32_t> nonTerminalFill(index.nonTerminalStarts.begin(), index.nonTerminalStarts.end() - 1),
+						  terminalFill(index.terminalStarts.begin(), index.terminalStarts.end() - 1);
+	for (size_t i = 0; i < RuleCount(gram); i++) {
+		RuleView rule = GetRule(gram, i);
+		for (uint32_t j = 0; j < rule.rightLength; j++) {
+			if (IsTerminal(rule.right[j])) {
+				index.rules[terminalBase + terminalFill[SymbolIndex(rule.right[j])]++] = (uint32_t)i;
+			}
+			else {
+				index.rules[nonTerminalFill[SymbolIndex(rule.right[j])]++] = (uint32_t)i;
+			}
+		}
+	}
+
+	return index;
+}
+
+const uint32_t* RightSideOccurrences(const RightSideIndex& index, Symbol symbol, size_t& count) {
+	// returns the rules (one entry per occurrence) that have the symbol on their right side
+	if (IsTerminal(symbol)) {
+		const uint32_t terminalBase = index.nonTerminalStarts.back();
+		count = index.terminalStarts[SymbolIndex(symbol) + 1] - index.terminalStarts[SymbolIndex(symbol)];
+		return index.rules.data() + terminalBase + index.terminalStarts[SymbolIndex(symbol)];
+	}
+
+	count = index.nonTerminalStarts[SymbolIndex(symbol) + 1] - index.nonTerminalStarts[SymbolIndex(symbol)];
+	return index.rules.data() + index.nonTerminalStarts[SymbolIndex(symbol)];
+}
+
+bool AppearsOnRightSide(const RightSideIndex& index, Symbol symbol) {
+	if (symbol == NoSymbol) {
+		return false;
+	}
+
+	const std::vector<uint32_t>& starts = IsTerminal(symbol) ? index.terminalStarts : index.nonTerminalStarts;
+	return starts[SymbolIndex(symbol) + 1] != starts[SymbolIndex(symbol)];
+}
+
+bool AppearsOnRightSide(const RightSideCounts& counts, Symbol symbol) {
+	return symbol != NoSymbol && !IsTerminal(symbol) && SymbolIndex(symbol) < counts.nonTerminals.size() && counts.nonTerminals[SymbolIndex(symbol)] > 0;
+}
+
+// IsType3 and IsType1 only look at the index for empty word rules, it can be a RightSideIndex or a RightSideCounts
+template <typename Index>
+bool IsType3(const RuleView& rule, const Index& index) {
+	if (rule.leftLength != 1 || IsTerminal(rule.left[0])) { // we need exactly one non-terminal on the left, otherwise it cannot be type 3 (or type 2)
+		return false;
+	}
+
+	uint32_t nonTerminalCount = 0, nonTerminalOffset = 0;
+	for (uint32_t i = 0; i < rule.rightLength; i++) {
+		if (!IsTerminal(rule.right[i])) {
+			nonTerminalCount++;
+			nonTerminalOffset = i;
+		}
+	}
+
+	if (nonTerminalCount == 0) { // if we can't find any non-terminal on the right, then we only have terminals
+		if (rule.rightLength == 0) { // if the right side consists of only the empty word...
+			// check if the left side non-terminal exists in any rule on the right-side
+			if (AppearsOnRightSide(index, rule.left[0])) { // if we do find it, it is not of type 3
+				return false;
+			}
+		}
+
+		return true; // otherwise, we're good
+	}
+
+	if (nonTerminalCount > 1) { // we have more than one nonterminal on the right hand side
+		return false;
+	}
+
+	if (nonTerminalOffset != 0 && nonTerminalOffset != rule.rightLength - 1) {
+		return false; // we have terminals on both the left and right sides of the non-terminal
+	}
+
+	return true; // we passed all checks, our rule is of type N -> T * N or N -> N T *
+}
+
+bool IsType2(const RuleView& rule) {
+	return (rule.leftLength == 1 && !IsTerminal(rule.left[0])); // we need exactly one non-terminal on the left, if we have more, the rule is at most of type 1.
+	// this is because the right-side can consist of any combination of non-terminals and terminals
+}
+
+template <typename Index>
+bool IsType1(const RuleView& rule, const Index& index, Symbol startingPoint) {
+	if (rule.rightLength == 0) { // if the right side consists of only the empty word
+		if (rule.leftLength != 1 || rule.left[0] != startingPoint) {
+			return false; // this means that the left side is not the starting point and therefore this can't be type 1
+		}
+
+		return !AppearsOnRightSide(index, startingPoint); // and say it is type 0 if the starting point appears in any rule
+	}
+
+	if (rule.leftLength > rule.rightLength) { // if the left hand side has more non-terminals/terminals than the right side, it's type 0
+		return false;
+	}
+
+	// we need a non-terminal on the left whose context is kept on the right (uAv -> uwv),
+	// so find how long the common prefix and the common suffix of both sides are
+	uint32_t prefixLength = 0;
+	while (prefixLength < rule.leftLength && rule.left[prefixLength] == rule.right[prefixLength]) {
+		prefixLength++;
+	}
+
+	const uint32_t shift = rule.rightLength - rule.leftLength;
+	uint32_t suffixStart = rule.leftLength;
+	while (suffixStart > 0 && rule.left[suffixStart - 1] == rule.right[suffixStart - 1 + shift]) {
+		suffixStart--;
+	}
+
+	for (uint32_t i = (suffixStart > 0) ? suffixStart - 1 : 0; i <= prefixLength && i < rule.leftLength; i++) {
+		if (!IsTerminal(rule.left[i])) { // everything before i is our left context and everything after it our right context
+			return true; // we passed all checks, this is a type 1 rule.
+		}
+	}
+
+	return false; // the context changes, so it's type 0
+}
+
+GrammarType TypeFromChecks(bool allType3, bool allType2, bool allType1) {
+	// the grammar has the most restrictive type that every one of its rules passes
+	if (allType3) {
+		return GrammarType::Type3;
+	}
+	if (allType2) {
+		return GrammarType::Type2;
+	}
+	return allType1 ? GrammarType::Type1 : GrammarType::Type0;
+}
+
+GrammarType IncrementalGrammarType(const Grammar& gram);
+
+GrammarType FindGrammarType(const Grammar& gram) {
+	STAT_PHASE(StatPhase::FindGrammarType);
+	if (gram.classification.enabled) { // the counts are already up to date
+		return IncrementalGrammarType(gram);
+	}
+
+	if (RuleCount(gram) == 0) {
+		return GrammarType::TypeNULL;
+	}
+
+	const RightSideIndex index = BuildRightSideIndex(gram); // so the empty word checks don't have to look through every rule
+
+	// a rule can be type 3 or 2 and still not be type 1 (A -> | with A not the starting point),
+	// so every check is kept separately, until neither type 2 nor type 1 is possible anymore
+	bool allType3 = true, allType2 = true, allType1 = true;
+	for (size_t i = 0; i < RuleCount(gram) && (allType2 || allType1); i++) {
+		RuleView rule = GetRule(gram, i);
+
+		if (allType3 && !IsType3(rule, index)) {
+			allType3 = false;
+		}
+
+		if (allType2 && !IsType2(rule)) {
+			allType2 = false;
+		}
+
+		if (allType1 && !IsType1(rule, index, gram.startingPoint)) {
+			allType1 = false;
+		}
+	}
+
+	return TypeFromChecks(allType3, allType2, allType1);
+}
+
+const size_t ParallelClassifyChunk = 16384; // rules per chunk handed to a thread
+
+GrammarType FindGrammarTypeParallel(const Grammar& gram, unsigned threads, size_t chunkSize = ParallelClassifyChunk) {
+	// every chunk clears the checks its rules fail, the grammar type is then read from what's left
+	const size_t ruleCount = RuleCount(gram);
+	if (threads <= 1 || ruleCount <= chunkSize || gram.classification.enabled) {
+		return FindGrammarType(gram); // which counts the phase itself
+	}
+
+	STAT_PHASE(StatPhase::FindGrammarType);
+
+	const RightSideIndex index = BuildRightSideIndex(gram);
+	std::atomic<size_t> nextChunk(0);
+	std::atomic<bool> allType3(true), allType2(true), allType1(true);
+
+	const size_t chunkCount = (ruleCount + chunkSize - 1) / chunkSize;
+	std::vector<std::thread> workers;
+	for (unsigned i = 0; i < threads && i < chunkCount; i++) {
+		workers.emplace_back([&]() {
+			// once neither type 2 nor type 1 is possible the grammar is type 0, and every thread stops
+			for (size_t chunk = nextChunk++; chunk < chunkCount && (allType2 || allType1); chunk = nextChunk++) {
+				bool chunkType3 = true, chunkType2 = true, chunkType1 = true;
+				const size_t end = std::min(ruleCount, (chunk + 1) * chunkSize);
+				for (size_t i = chunk * chunkSize; i < end && (chunkType2 || chunkType1); i++) {
+					RuleView rule = GetRule(gram, i);
+					chunkType3 = chunkType3 && IsType3(rule, index);
+					chunkType2 = chunkType2 && IsType2(rule);
+					chunkType1 = chunkType1 && IsType1(rule, index, gram.startingPoint);
+				}
+
+				if (!chunkType3) {
+					allType3 = false;
+				}
+				if (!chunkType2) {
+					allType2 = false;
+				}
+				if (!chunkType1) {
+					allType1 = false;
+				}
+			}
+		});
+	}
+
+	for (std::vector<std::thread>::iterator it = workers.begin(); it != workers.end(); it++) {
+		it->join();
+	}
+
+	return TypeFromChecks(allType3, allType2, allType1);
+}
+
+// Incremental classification functions
+
+const uint8_t RuleIsType3 = 1,
+			  RuleIsType2 = 2,
+			  RuleIsType1 = 4,
+			  RuleIsEmptyWord = 8; // A -> |, whose type 3 and type 1 checks depend on the rest of the grammar
+
+bool IsEmptyWordRule(const RuleView& rule) {
+	return rule.leftLength == 1 && !IsTerminal(rule.left[0]) && rule.rightLength == 0;
+}
+
+uint8_t ClassifyRule(const RuleView& rule, const RightSideCounts& counts) {
+	if (IsEmptyWordRule(rule)) {
+		return RuleIsEmptyWord | RuleIsType2;
+	}
+
+	return (IsType3(rule, counts) ? RuleIsType3 : 0) | (IsType2(rule) ? RuleIsType2 : 0) | (IsType1(rule, counts, NoSymbol) ? RuleIsType1 : 0);
+}
+
+void CountRule(Grammar& gram, size_t ruleIndex, bool adding) {
+	IncrementalClassification& state = gram.classification;
+	RuleView rule = GetRule(gram, ruleIndex);
+	const uint8_t flags = state.ruleFlags[ruleIndex];
+
+	if (state.emptyWordRules.size() < gram.nonTerminals.size()) { // non-terminals may have been added since
+		state.emptyWordRules.resize(gram.nonTerminals.size(), 0);
+		state.rightSide.nonTerminals.resize(gram.nonTerminals.size(), 0);
+	}
+
+	for (uint32_t i = 0; i < rule.rightLength; i++) {
+		if (IsTerminal(rule.right[i])) {
+			continue;
+		}
+
+		// an empty word rule stops being type 3 while its non-terminal is used on some right side
+		uint32_t& count = state.rightSide.nonTerminals[SymbolIndex(rule.right[i])];
+		if (adding && count++ == 0) {
+			state.usedEmptyWordRules += state.emptyWordRules[SymbolIndex(rule.right[i])];
+		}
+		else if (!adding && --count == 0) {
+			state.usedEmptyWordRules -= state.emptyWordRules[SymbolIndex(rule.right[i])];
+		}
+	}
+
+	if (flags & RuleIsEmptyWord) {
+		const uint32_t nonTerminal = SymbolIndex(rule.left[0]);
+		const size_t used = (state.rightSide.nonTerminals[nonTerminal] > 0) ? 1 : 0;
+		if (adding) {
+			state.emptyWordRules[nonTerminal]++;
+			state.emptyWordCount++;
+			state.usedEmptyWordRules += used;
+		}
+		else {
+			state.emptyWordRules[nonTerminal]--;
+			state.emptyWordCount--;
+			state.usedEmptyWordRules -= used;
+		}
+		return;
+	}
+
+	const size_t change = adding ? 1 : (size_t)-1;
+	state.notType3 += (flags & RuleIsType3) ? 0 : change;
+	state.notType2 += (flags & RuleIsType2) ? 0 : change;
+	state.notType1 += (flags & RuleIsType1) ? 0 : change;
+}
+
+void AddRuleToClassification(Grammar& gram, size_t ruleIndex) {
+	if (gram.classification.enabled) {
+		gram.classification.ruleFlags.push_back(ClassifyRule(GetRule(gram, ruleIndex), gram.classification.rightSide));
+		CountRule(gram, ruleIndex, true);
+	}
+}
+
+void EnableIncrementalClassification(Grammar& gram) {
+	// classifies every rule once, afterwards adding or removing a rule only updates the counts
+	gram.classification = IncrementalClassification();
+	gram.classification.enabled = true;
+	gram.classification.ruleFlags.reserve(RuleCount(gram));
+	for (size_t i = 0; i < RuleCount(gram); i++) {
+		AddRuleToClassification(gram, i);
+	}
+}
+
+GrammarType IncrementalGrammarType(const Grammar& gram) {
+	const IncrementalClassification& state = gram.classification;
+	if (state.ruleFlags.empty()) {
+		return GrammarType::TypeNULL;
+	}
+
+	// A -> | is type 3 unless A is on a right side, and type 1 only for the starting point when it isn't on a right side
+	size_t startEmptyWordRules = 0;
+	if (gram.startingPoint != NoSymbol && !IsTerminal(gram.startingPoint) && SymbolIndex(gram.startingPoint) < state.emptyWordRules.size()) {
+		startEmptyWordRules = state.emptyWordRules[SymbolIndex(gram.startingPoint)];
+	}
+
+	const size_t notType3 = state.notType3 + state.usedEmptyWordRules,
+				 notType1 = state.notType1 + (state.emptyWordCount - startEmptyWordRules) + (AppearsOnRightSide(state.rightSide, gram.startingPoint) ? startEmptyWordRules : 0);
+
+	return TypeFromChecks(notType3 == 0, state.notType2 == 0, notType1 == 0);
+}
+
+// Functions used across all closure properties
+
+struct SymbolMap { // where every symbol of a source grammar ended up in the grammar we are building
+	std::vector<Symbol> nonTerminals,
+						terminals;
+};
+
+Symbol MapSymbol(const SymbolMap& map, Symbol symbol) {
+	return IsTerminal(symbol) ? map.terminals[SymbolIndex(symbol)] : map.nonTerminals[SymbolIndex(symbol)];
+}
+
+void AddTerminals(Grammar& newGram, const Grammar& otherGram, SymbolMap& map) {
+	STAT_PHASE(StatPhase::AddTerminals);
+	map.terminals.clear();
+	map.terminals.reserve(otherGram.terminals.size());
+	for (ArenaVector<std::string_view>::const_iterator itO = otherGram.terminals.begin(); itO != otherGram.terminals.end(); itO++) {
+		map.terminals.push_back(AddTerminal(newGram, *itO)); // terminals with the same name are the same terminal
+	}
+}
+
+struct FreshNames { // hands out names that aren't taken in the grammar being built, by adding 's to the wanted name
+	// how many 's we know to be taken already, indexed by the symbol that took the wanted name first
+	std::vector<uint32_t> nonTerminalPrimes,
+						  terminalPrimes;
+	std::string name; // reused for every name we try
+};
+
+Symbol AddFreshNonTerminal(Grammar& newGram, FreshNames& names, std::string_view wanted) {
+	STAT_COUNT(StatCounter::FreshNameAttempts, 1);
+	const Symbol taken = FindSymbol(newGram, wanted);
+	if (taken == NoSymbol) { // most names don't clash, and those don't need to be remembered
+		return AddNonTerminal(newGram, wanted);
+	}
+
+	std::vector<uint32_t>& counters = IsTerminal(taken) ? names.terminalPrimes : names.nonTerminalPrimes;
+	if (counters.size() <= SymbolIndex(taken)) {
+		counters.resize(std::max<size_t>(SymbolIndex(taken) + 1, 2 * counters.size()), 0);
+	}
+
+	uint32_t& primes = counters[SymbolIndex(taken)]; // so a name that clashes k times costs O(k) over the whole build, not O(k) per clash
+	names.name.assign(wanted);
+	names.name.append(primes, '\'');
+	while (FindSymbol(newGram, names.name) != NoSymbol) { // while our name is already taken by a terminal or a non-terminal
+		names.name.push_back('\''); // add another ' to differentiate it from the others
+		primes++;
+		STAT_COUNT(StatCounter::FreshNameAttempts, 1);
+	}
+	primes++;
+
+	return AddNonTerminal(newGram, names.name);
+}
+
+Symbol MapStartingPoint(Grammar& newGram, FreshNames& names, const Grammar& otherGram, const SymbolMap& map) {
+	// a grammar without a starting point (one without non-terminals) has the empty language, which a new non-terminal without rules stands for
+	if (otherGram.startingPoint == NoSymbol) {
+		return AddFreshNonTerminal(newGram, names, "S");
+	}
+
+	return MapSymbol(map, otherGram.startingPoint);
+}
+
+void AddNonTerminals(Grammar& newGram, FreshNames& names, const Grammar& otherGram, SymbolMap& map) {
+	// adds the non-terminals, renaming the ones that clash with symbols already in the new grammar
+	// the terminals must be added first, so that no non-terminal takes the name of a terminal
+	STAT_PHASE(StatPhase::AddNonTerminals);
+	map.nonTerminals.clear();
+	map.nonTerminals.reserve(otherGram.nonTerminals.size());
+	for (ArenaVector<std::string_view>::const_iterator itO = otherGram.nonTerminals.begin(); itO != otherGram.nonTerminals.end(); itO++) {
+		map.nonTerminals.push_back(AddFreshNonTerminal(newGram, names, *itO));
+	}
+}
+
+void AddMappedRules(Grammar& newGram, const Grammar& otherGram, const SymbolMap& map) {
+	// every rename is already in the map, so all the rules are rewritten in a single pass over the flat arrays
+	STAT_PHASE(StatPhase::AddMappedRules);
+	STAT_COUNT(StatCounter::RuleRewrites, RuleCount(otherGram));
+	OwnRules(newGram);
+	const Symbol* otherSymbols = RuleSymbolData(otherGram);
+	const uint32_t* otherOffsets = RuleOffsetData(otherGram);
+	const size_t otherSymbolCount = RuleSymbolCount(otherGram),
+				 otherOffsetCount = 2 * RuleCount(otherGram) + 1;
+
+	const size_t symbolBase = newGram.ruleSymbols.size();
+	newGram.ruleSymbols.resize(symbolBase + otherSymbolCount);
+	for (size_t i = 0; i < otherSymbolCount; i++) {
+		newGram.ruleSymbols[symbolBase + i] = MapSymbol(map, otherSymbols[i]);
+	}
+
+	const size_t offsetBase = newGram.ruleOffsets.size();
+	newGram.ruleOffsets.resize(offsetBase + otherOffsetCount - 1);
+	for (size_t i = 1; i < otherOffsetCount; i++) {
+		newGram.ruleOffsets[offsetBase + i - 1] = (uint32_t)symbolBase + otherOffsets[i];
+	}
+
+	for (size_t i = RuleCount(newGram) - RuleCount(otherGram); i < RuleCount(newGram); i++) {
+		AddRuleToClassification(newGram, i);
+	}
+}
+
+bool HasNonTerminal(const Symbol* symbols, uint32_t length) {
+	for (uint32_t i = 0; i < length; i++) {
+		if (!IsTerminal(symbols[i])) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+const uint32_t NoRule = 0xFFFFFFFFu;
+
+inline bool HasBit(const std::vector<uint64_t>& bits, uint32_t index) {
+	return ((bits[index >> 6] >> (index & 63)) & 1) != 0;
+}
+
+inline void SetBit(std::vector<uint64_t>& bits, uint32_t index) {
+	bits[index >> 6] |= (uint64_t)1 << (index & 63);
+}
+
+inline bool IsContextFreeRule(const RuleView& rule) {
+	return rule.leftLength == 1 && !IsTerminal(rule.left[0]);
+}
+
+std::vector<uint64_t> FindDerivingNonTerminals(const Grammar& gram, const RightSideIndex& index, bool emptyWordOnly, std::vector<uint32_t>* foundBy = nullptr) {
+	// the non-terminals that derive some word, or only the empty word, as a worklist over the rules: a rule counts once every
+	// non-terminal on its right does, and for the empty word a terminal never does. rules with more than a non-terminal
+	// on the left are left out, so for grammars of type 1 and 0 the set is only as much as their context-free rules show.
+	// foundBy remembers the rule every non-terminal was found through, so following them down never goes round in circles
+	std::vector<uint64_t> found((gram.nonTerminals.size() + 63) / 64, 0);
+	if (foundBy) {
+		foundBy->assign(gram.nonTerminals.size(), NoRule);
+	}
+	std::vector<uint32_t> remaining(RuleCount(gram)), worklist;
+	for (size_t i = 0; i < RuleCount(gram); i++) {
+		RuleView rule = GetRule(gram, i);
+		if (!IsContextFreeRule(rule)) {
+			remaining[i] = ~0u;
+			continue;
+		}
+
+		remaining[i] = emptyWordOnly ? rule.rightLength : (uint32_t)(rule.rightLength - std::count_if(rule.right, rule.right + rule.rightLength, IsTerminal));
+		if (remaining[i] == 0 && !HasBit(found, rule.left[0])) {
+			SetBit(found, rule.left[0]);
+			worklist.push_back(rule.left[0]);
+			if (foundBy) {
+				(*foundBy)[rule.left[0]] = (uint32_t)i;
+			}
+		}
+	}
+
+	while (!worklist.empty()) {
+		const Symbol nonTerminal = worklist.back();
+		worklist.pop_back();
+
+		size_t count = 0;
+		const uint32_t* occurrences = RightSideOccurrences(index, nonTerminal, count);
+		for (size_t i = 0; i < count; i++) {
+			if (remaining[occurrences[i]] == ~0u) {
+				continue;
+			}
+
+			const Symbol left = GetRule(gram, occurrences[i]).left[0];
+			if (--remaining[occurrences[i]] == 0 && !HasBit(found, left)) {
+				SetBit(found, left);
+				worklist.push_back(left);
+				if (foundBy) {
+					(*foundBy)[left] = occurrences[i];
+				}
+			}
+		}
+	}
+
+	return found;
+}
+
+std::vector<uint64_t> FindNullableNonTerminals(const Grammar& gram, std::vector<uint32_t>* emptyRules = nullptr) {
+	// the non-terminals that derive the empty word, as a bitset, with the rule that does it for every one of them in emptyRules
+	// without a single A -> | rule nothing is nullable, which is cheap to find out and saves building the index
+	const uint32_t* offsets = RuleOffsetData(gram);
+	bool anyEmptyWordRule = false;
+	for (size_t i = 0; i < RuleCount(gram) && !anyEmptyWordRule; i++) {
+		anyEmptyWordRule = offsets[2 * i + 1] == offsets[2 * i + 2];
+	}
+	if (!anyEmptyWordRule) {
+		if (emptyRules) {
+			emptyRules->assign(gram.nonTerminals.size(), NoRule);
+		}
+		return std::vector<uint64_t>((gram.nonTerminals.size() + 63) / 64, 0);
+	}
+
+	return FindDerivingNonTerminals(gram, BuildRightSideIndex(gram), true, emptyRules);
+}
+
+bool IsNullable(const Grammar& gram, Symbol nonTerminal) {
+	return nonTerminal != NoSymbol && !IsTerminal(nonTerminal) && HasBit(FindNullableNonTerminals(gram), nonTerminal);
+}
+
+// Union functions
+Grammar CreateGrammarFromUnion(const Grammar* const* grams, size_t count) {
+	// any number of grammars in one pass, the new starting point going to every one of their starting points
+	STAT_PHASE(StatPhase::Union);
+	Grammar newGram;
+	std::vector<SymbolMap> maps(count);
+	FreshNames names;
+	size_t symbolCount = 1, ruleCount = count, ruleSymbolCount = 2 * count;
+	for (size_t i = 0; i < count; i++) {
+		symbolCount += SymbolCount(*grams[i]);
+		ruleCount += RuleCount(*grams[i]);
+		ruleSymbolCount += RuleSymbolCount(*grams[i]);
+	}
+	ReserveGrammar(newGram, symbolCount, ruleCount, ruleSymbolCount);
+
+	for (size_t i = 0; i < count; i++) {
+		AddTerminals(newGram, *grams[i], maps[i]);
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		AddNonTerminals(newGram, names, *grams[i], maps[i]);
+		if (i == 0) {
+			newGram.startingPoint = AddFreshNonTerminal(newGram, names, "S"); // we make a new starting point
+		}
+	}
+	if (count == 0) {
+		newGram.startingPoint = AddFreshNonTerminal(newGram, names, "S");
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		AddMappedRules(newGram, *grams[i], maps[i]);
+		AddProductionRule(newGram, { newGram.startingPoint }, { MapStartingPoint(newGram, names, *grams[i], maps[i]) });
+	}
+
+	return newGram;
+}
+
+Grammar CreateGrammarFromUnion(const Grammar& gram1, const Grammar& gram2) {
+	const Grammar* grams[2] = { &gram1, &gram2 };
+	return CreateGrammarFromUnion(grams, 2);
+}
+
+// Product functions
+void AddProductionRulesProduct3(Grammar& newGram, const Grammar& gram1, const SymbolMap& map1, Symbol secondStart) {
+	// every rule of the first grammar that ends the derivation continues it into the second grammar instead
+	STAT_COUNT(StatCounter::RuleRewrites, RuleCount(gram1));
+	std::vector<Symbol> left, right;
+	for (size_t i = 0; i < RuleCount(gram1); i++) {
+		RuleView rule = GetRule(gram1, i);
+
+		left.clear();
+		for (uint32_t j = 0; j < rule.leftLength; j++) {
+			left.push_back(MapSymbol(map1, rule.left[j]));
+		}
+
+		right.clear();
+		for (uint32_t j = 0; j < rule.rightLength; j++) {
+			right.push_back(MapSymbol(map1, rule.right[j]));
+		}
+
+		if (!HasNonTerminal(rule.right, rule.rightLength)) {
+			right.push_back(secondStart);
+		}
+
+		AddProductionRule(newGram, left, right);
+	}
+}
+
+Grammar CreateGrammarFromProduct(const Grammar* const* grams, size_t count) {
+	// any number of grammars in one pass. if they are all of type 3, every grammar but the last continues into the next one
+	// where it would end the word, so the product stays type 3, otherwise a new starting point goes to all their starting points in order
+	STAT_PHASE(StatPhase::Product);
+	Grammar newGram;
+	std::vector<SymbolMap> maps(count);
+	FreshNames names;
+	size_t symbolCount = 1, ruleCount = 1, ruleSymbolCount = 1 + count;
+	bool allType3 = count > 0;
+	for (size_t i = 0; i < count; i++) {
+		symbolCount += SymbolCount(*grams[i]);
+		ruleCount += RuleCount(*grams[i]);
+		ruleSymbolCount += RuleSymbolCount(*grams[i]) + RuleCount(*grams[i]);
+		allType3 = allType3 && FindGrammarType(*grams[i]) == GrammarType::Type3;
+	}
+	ReserveGrammar(newGram, symbolCount, ruleCount, ruleSymbolCount);
+
+	for (size_t i = 0; i < count; i++) {
+		AddTerminals(newGram, *grams[i], maps[i]);
+	}
+
+	if (allType3) {
+		for (size_t i = 0; i < count; i++) {
+			AddNonTerminals(newGram, names, *grams[i], maps[i]);
+		}
+		newGram.startingPoint = MapStartingPoint(newGram, names, *grams[0], maps[0]);
+
+		for (size_t i = 0; i + 1 < count; i++) {
+			AddProductionRulesProduct3(newGram, *grams[i], maps[i], MapStartingPoint(newGram, names, *grams[i + 1], maps[i + 1]));
+		}
+		AddMappedRules(newGram, *grams[count - 1], maps[count - 1]);
+	}
+	else {
+		for (size_t i = 0; i < count; i++) {
+			AddNonTerminals(newGram, names, *grams[i], maps[i]);
+			if (i == 0) {
+				newGram.startingPoint = AddFreshNonTerminal(newGram, names, "S"); // we make a new starting point
+			}
+		}
+		if (count == 0) { // the product of no languages only has the empty word
+			newGram.startingPoint = AddFreshNonTerminal(newGram, names, "S");
+		}
+
+		std::vector<Symbol> starts;
+		for (size_t i = 0; i < count; i++) {
+			AddMappedRules(newGram, *grams[i], maps[i]);
+			starts.push_back(MapStartingPoint(newGram, names, *grams[i], maps[i]));
+		}
+		AddProductionRule(newGram, { newGram.startingPoint }, starts);
+	}
+
+	return newGram;
+}
+
+Grammar CreateGrammarFromProduct(const Grammar& gram1, const Grammar& gram2) {
+	const Grammar* grams[2] = { &gram1, &gram2 };
+	return CreateGrammarFromProduct(grams, 2);
+}
+
+// Closure functions
+// when the other starting point derives the empty word already, S -> | is redundant and left out
+
+void AddProductionRulesClosure01(Grammar& newGram, const Grammar& otherGram, const SymbolMap& map, Symbol newNT) {
+	const Symbol otherStart = MapSymbol(map, otherGram.startingPoint);
+
+	AddProductionRule(newGram, { newGram.startingPoint }, { otherStart });
+	if (!IsNullable(otherGram, otherGram.startingPoint)) {
+		AddProductionRule(newGram, { newGram.startingPoint }, {});
+	}
+	AddProductionRule(newGram, { newGram.startingPoint }, { newNT, otherStart });
+
+	for (std::vector<Symbol>::const_iterator itO = map.terminals.begin(); itO != map.terminals.end(); itO++) {
+		AddProductionRule(newGram, { newNT, *itO }, { otherStart, *itO });
+		AddProductionRule(newGram, { newNT, *itO }, { newNT, otherStart, *itO });
+	}
+}
+
+void AddProductionRulesClosure2(Grammar& newGram, const Grammar& otherGram, const SymbolMap& map) {
+	AddProductionRule(newGram, { newGram.startingPoint }, { newGram.startingPoint, MapSymbol(map, otherGram.startingPoint) });
+	if (IsNullable(otherGram, otherGram.startingPoint)) { // S -> S S' still needs a way out, which S' gives, the empty word included
+		AddProductionRule(newGram, { newGram.startingPoint }, { MapSymbol(map, otherGram.startingPoint) });
+	}
+	else {
+		AddProductionRule(newGram, { newGram.startingPoint }, {});
+	}
+}
+
+void AddProductionRulesClosure3(Grammar& newGram, const Grammar& otherGram, const SymbolMap& map) {
+	const Symbol otherStart = MapSymbol(map, otherGram.startingPoint);
+
+	std::vector<Symbol> left, right;
+	for (size_t i = 0; i < RuleCount(otherGram); i++) {
+		RuleView rule = GetRule(otherGram, i);
+		if (!HasNonTerminal(rule.right, rule.rightLength)) { // every rule that ends a word may start another one
+			STAT_COUNT(StatCounter::RuleRewrites, 1);
+			left.assign(1, MapSymbol(map, rule.left[0]));
+
+			right.clear();
+			for (uint32_t j = 0; j < rule.rightLength; j++) {
+				right.push_back(MapSymbol(map, rule.right[j]));
+			}
+			right.push_back(otherStart);
+
+			AddProductionRule(newGram, left, right);
+		}
+	}
+
+	AddProductionRule(newGram, { newGram.startingPoint }, { otherStart });
+	if (!IsNullable(otherGram, otherGram.startingPoint)) {
+		AddProductionRule(newGram, { newGram.startingPoint }, {});
+	}
+}
+
+Grammar CreateGrammarFromClosure(const Grammar& gram1) {
+	STAT_PHASE(StatPhase::Closure);
+	Grammar newGram;
+	SymbolMap map;
+	FreshNames names;
+
+	GrammarType type = FindGrammarType(gram1);
+	if (type == GrammarType::TypeNULL) {
+		return newGram;
+	}
+	if (gram1.startingPoint == NoSymbol) { // the closure of the empty language only has the empty word
+		AddTerminals(newGram, gram1, map);
+		newGram.startingPoint = AddFreshNonTerminal(newGram, names, "S");
+		AddProductionRule(newGram, { newGram.startingPoint }, {});
+		return newGram;
+	}
+
+	// at most every rule is added twice (type 3), and type 0 and 1 add two rules for every terminal
+	ReserveGrammar(newGram, SymbolCount(gram1) + 2, 2 * RuleCount(gram1) + 2 * gram1.terminals.size() + 3, 2 * RuleSymbolCount(gram1) + RuleCount(gram1) + 7 * gram1.terminals.size() + 5);
+	AddTerminals(newGram, gram1, map);
+	AddNonTerminals(newGram, names, gram1, map);
+	newGram.startingPoint = AddFreshNonTerminal(newGram, names, "S"); // we make a new starting point
+
+	AddMappedRules(newGram, gram1, map);
+
+	switch (type) {
+		case GrammarType::Type0:
+		case GrammarType::Type1: {
+			AddProductionRulesClosure01(newGram, gram1, map, AddFreshNonTerminal(newGram, names, "X"));
+			break;
+		}
+		case GrammarType::Type2: {
+			AddProductionRulesClosure2(newGram, gram1, map);
+			break;
+		}
+		case GrammarType::Type3: {
+			AddProductionRulesClosure3(newGram, gram1, map);
+			break;
+		}
+		default: {
+			break;
+		}
+	}
+
+	return newGram;
+}
+
+// File functions
+
+/*	Grammar text format, one statement per line:
+
+	# a comment runs until the end of the line
+	nonterminals: S A B
+	terminals: a b 0 1
+	start: S
+	S -> a A | b B |
+	  | 0 S 1
+	X a -> S a
+
+	Symbols are separated by whitespace, "->" and "|" (which also separate symbols when they are glued to them).
+	Every symbol has to be declared before a rule uses it. The alternatives of a rule are split by "|", an empty
+	alternative being the empty word, and a line starting with "|" adds more alternatives to the rule above it.
+	Without a "start:" line the first non-terminal is the starting point.
+*/
+
+const size_t LoadChunkSize = 1 << 20;
+
+struct GrammarFileParser {
+	Grammar& gram;
+	size_t lineNumber = 0;
+	std::vector<std::string_view> tokens; // views into the current line, nothing is copied until a symbol is declared
+	std::vector<Symbol> left, right; // left keeps the left side of the last rule, for continuation lines
+	std::string error;
+
+	GrammarFileParser(Grammar& gram) : gram(gram) {}
+};
+
+void SplitLine(std::string_view line, std::vector<std::string_view>& tokens) {
+	tokens.clear();
+	size_t i = 0;
+	while (i < line.size()) {
+		const char c = line[i];
+		if (c == ' ' || c == '\t' || c == '\r') {
+			i++;
+		}
+		else if (c == '#') { // the rest of the line is a comment
+			break;
+		}
+		else if (c == '|') {
+			tokens.push_back(line.substr(i, 1));
+			i++;
+		}
+		else if (c == '-' && i + 1 < line.size() && line[i + 1] == '>') {
+			tokens.push_back(line.substr(i, 2));
+			i += 2;
+		}
+		else {
+			const size_t start = i;
+			while (i < line.size() && line[i] != ' ' && line[i] != '\t' && line[i] != '\r' && line[i] != '|' && !(line[i] == '-' && i + 1 < line.size() && line[i + 1] == '>')) {
+				i++;
+			}
+			tokens.push_back(line.substr(start, i - start));
+		}
+	}
+}
+
+bool FailLine(GrammarFileParser& parser, const std::string& message) {
+	parser.error = "line " + std::to_string(parser.lineNumber) + ": " + message;
+	return false;
+}
+
+bool AddAlternatives(GrammarFileParser& parser, size_t firstToken) {
+	// every "|" closes an alternative, and the end of the line closes the last one
+	parser.right.clear();
+	for (size_t i = firstToken; i <= parser.tokens.size(); i++) {
+		if (i == parser.tokens.size() || parser.tokens[i] == "|") {
+			AddProductionRule(parser.gram, parser.left, parser.right);
+			parser.right.clear();
+			continue;
+		}
+
+		if (parser.tokens[i] == "->") {
+			return FailLine(parser, "a rule can only have one \"->\"");
+		}
+
+		const Symbol symbol = FindSymbol(parser.gram, parser.tokens[i]);
+		if (symbol == NoSymbol) {
+			return FailLine(parser, "undeclared symbol \"" + std::string(parser.tokens[i]) + "\"");
+		}
+		parser.right.push_back(symbol);
+	}
+
+	return true;
+}
+
+bool ParseGrammarLine(GrammarFileParser& parser, std::string_view line) {
+	parser.lineNumber++;
+	SplitLine(line, parser.tokens);
+	if (parser.tokens.empty()) {
+		return true;
+	}
+
+	const std::string_view first = parser.tokens[0];
+	if (first == "nonterminals:" || first == "terminals:") {
+		for (size_t i = 1; i < parser.tokens.size(); i++) {
+			const std::string name(parser.tokens[i]);
+			if (name == "|" || name == "->") {
+				return FailLine(parser, "\"" + name + "\" can't be the name of a symbol");
+			}
+
+			if (FindSymbol(parser.gram, name) != NoSymbol) {
+				return FailLine(parser, "symbol \"" + name + "\" is declared twice");
+			}
+
+			if (first == "nonterminals:") {
+				AddNonTerminal(parser.gram, name);
+			}
+			else {
+				AddTerminal(parser.gram, name);
+			}
+		}
+		return true;
+	}
+
+	if (first == "start:") {
+		if (parser.tokens.size() != 2) {
+			return FailLine(parser, "\"start:\" takes exactly one non-terminal");
+		}
+
+		const Symbol symbol = FindSymbol(parser.gram, parser.tokens[1]);
+		if (symbol == NoSymbol || IsTerminal(symbol)) {
+			return FailLine(parser, "\"" + std::string(parser.tokens[1]) + "\" is not a declared non-terminal");
+		}
+		parser.gram.startingPoint = symbol;
+		return true;
+	}
+
+	if (first == "|") { // more alternatives for the rule on the lines above
+		if (parser.left.empty()) {
+			return FailLine(parser, "there is no rule to continue");
+		}
+		return AddAlternatives(parser, 1);
+	}
+
+	parser.left.clear();
+	size_t i = 0;
+	for (; i < parser.tokens.size() && parser.tokens[i] != "->"; i++) {
+		const Symbol symbol = FindSymbol(parser.gram, parser.tokens[i]);
+		if (symbol == NoSymbol) {
+			return FailLine(parser, (parser.tokens[i] == "|") ? std::string("\"|\" can't be on the left side of a rule") : "undeclared symbol \"" + std::string(parser.tokens[i]) + "\"");
+		}
+		parser.left.push_back(symbol);
+	}
+
+	if (i == parser.tokens.size()) {
+		return FailLine(parser, "expected \"->\"");
+	}
+	if (parser.left.empty()) {
+		return FailLine(parser, "the left side of a rule can't be empty");
+	}
+
+	return AddAlternatives(parser, i + 1);
+}
+
+bool LoadGrammar(std::istream& input, Grammar& gram, std::string& error) {
+	// reads the input in large chunks and parses every complete line straight out of the buffer,
+	// only the unfinished line at the end of a chunk is moved to the front before reading the next one
+	STAT_PHASE(StatPhase::LoadGrammar);
+	gram = Grammar();
+	GrammarFileParser parser(gram);
+
+	std::vector<char> buffer(LoadChunkSize);
+	size_t carried = 0;
+	bool atEnd = false;
+	while (!atEnd) {
+		if (carried == buffer.size()) { // a single line doesn't fit into the buffer
+			buffer.resize(buffer.size() * 2);
+		}
+
+		input.read(buffer.data() + carried, buffer.size() - carried);
+		const size_t filled = carried + (size_t)input.gcount();
+		atEnd = !input;
+
+		size_t lineStart = 0;
+		while (true) {
+			const char* newLine = (const char*)memchr(buffer.data() + lineStart, '\n', filled - lineStart);
+			if (newLine == nullptr) {
+				break;
+			}
+
+			const size_t lineEnd = newLine - buffer.data();
+			if (!ParseGrammarLine(parser, std::string_view(buffer.data() + lineStart, lineEnd - lineStart))) {
+				error = parser.error;
+				return false;
+			}
+			lineStart = lineEnd + 1;
+		}
+
+		if (atEnd && lineStart < filled) { // the last line doesn't have to end with a new line
+			if (!ParseGrammarLine(parser, std::string_view(buffer.data() + lineStart, filled - lineStart))) {
+				error = parser.error;
+				return false;
+			}
+			lineStart = filled;
+		}
+
+		carried = filled - lineStart;
+		memmove(buffer.data(), buffer.data() + lineStart, carried);
+	}
+
+	if (gram.startingPoint == NoSymbol && !gram.nonTerminals.empty()) {
+		gram.startingPoint = 0;
+	}
+
+	return true;
+}
+
+void SaveGrammar(std::ostream& output, const Grammar& gram) {
+	// writes the grammar in the text format above, one rule per line ("S ->" being S -> the empty word)
+	output << "nonterminals:";
+	for (ArenaVector<std::string_view>::const_iterator it = gram.nonTerminals.begin(); it != gram.nonTerminals.end(); it++) {
+		output << ' ' << *it;
+	}
+
+	output << "\nterminals:";
+	for (ArenaVector<std::string_view>::const_iterator it = gram.terminals.begin(); it != gram.terminals.end(); it++) {
+		output << ' ' << *it;
+	}
+	output << '\n';
+
+	if (gram.startingPoint != NoSymbol) {
+		output << "start: " << SymbolName(gram, gram.startingPoint) << '\n';
+	}
+
+	for (size_t i = 0; i < RuleCount(gram); i++) {
+		RuleView rule = GetRule(gram, i);
+		for (uint32_t j = 0; j < rule.leftLength; j++) {
+			output << SymbolName(gram, rule.left[j]) << ' ';
+		}
+		output << "->";
+		for (uint32_t j = 0; j < rule.rightLength; j++) {
+			output << ' ' << SymbolName(gram, rule.right[j]);
+		}
+		output << '\n';
+	}
+}
+
+/*	Binary grammar format, everything in native byte order:
+
+	BinaryGrammarHeader
+	uint32_t nameOffsets[nonTerminalCount + terminalCount + 1]	where every name starts in the name block, non-terminals first
+	char names[nameBytes], padded with zeroes to a multiple of 4
+	uint32_t ruleOffsets[2 * ruleCount + 1]						the same layout as Grammar::ruleOffsets
+	Symbol ruleSymbols[ruleSymbolCount]							the same layout as Grammar::ruleSymbols
+
+	The file is mapped into memory and the rules are used from it in place, only the symbol table is rebuilt.
+*/
+
+const char BinaryGrammarMagic[4] = { 'G', 'R', 'M', 'B' };
+const uint32_t BinaryGrammarVersion = 1;
+
+struct BinaryGrammarHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t grammarType; // FindGrammarType of the saved grammar, so it doesn't need to be classified again
+	uint32_t startingPoint;
+	uint32_t nonTerminalCount,
+			 terminalCount;
+	uint32_t nameBytes;
+	uint32_t ruleCount;
+	uint32_t ruleSymbolCount;
+};
+
+struct MappedFile {
+	const char* data = nullptr;
+	size_t size = 0;
+#ifdef _WIN32
+	HANDLE file = INVALID_HANDLE_VALUE,
+		   mapping = NULL;
+#endif
+
+	~MappedFile() {
+#ifdef _WIN32
+		if (data) {
+			UnmapViewOfFile(data);
+		}
+		if (mapping) {
+			CloseHandle(mapping);
+		}
+		if (file != INVALID_HANDLE_VALUE) {
+			CloseHandle(file);
+		}
+#else
+		if (data) {
+			munmap((void*)data, size);
+		}
+#endif
+	}
+};
+
+std::shared_ptr<MappedFile> MapFile(const std::string& path) {
+	std::shared_ptr<MappedFile> mapped = std::make_shared<MappedFile>();
+#ifdef _WIN32
+	mapped->file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	LARGE_INTEGER size;
+	if (mapped->file == INVALID_HANDLE_VALUE || !GetFileSizeEx(mapped->file, &size) || size.QuadPart == 0) {
+		return nullptr;
+	}
+
+	mapped->mapping = CreateFileMappingA(mapped->file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!mapped->mapping) {
+		return nullptr;
+	}
+
+	mapped->data = (const char*)MapViewOfFile(mapped->mapping, FILE_MAP_READ, 0, 0, 0);
+	mapped->size = (size_t)size.QuadPart;
+#else
+	const int file = open(path.c_str(), O_RDONLY);
+	if (file < 0) {
+		return nullptr;
+	}
+
+	struct stat status;
+	if (fstat(file, &status) != 0 || status.st_size == 0) {
+		close(file);
+		return nullptr;
+	}
+
+	void* data = mmap(nullptr, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+	close(file); // the mapping stays valid without the descriptor
+	if (data == MAP_FAILED) {
+		return nullptr;
+	}
+
+	mapped->data = (const char*)data;
+	mapped->size = (size_t)status.st_size;
+#endif
+
+	return mapped->data ? mapped : nullptr;
+}
+
+inline size_t PadTo4(size_t size) {
+	return (size + 3) & ~(size_t)3;
+}
+
+bool SaveGrammarBinary(const std::string& path, const Grammar& gram, std::string& error) {
+	std::ofstream file(path, std::ios::binary);
+	if (!file) {
+		error = "can't create \"" + path + "\"";
+		return false;
+	}
+
+	BinaryGrammarHeader header;
+	memcpy(header.magic, BinaryGrammarMagic, sizeof(header.magic));
+	header.version = BinaryGrammarVersion;
+	header.grammarType = (uint32_t)FindGrammarType(gram);
+	header.startingPoint = gram.startingPoint;
+	header.nonTerminalCount = (uint32_t)gram.nonTerminals.size();
+	header.terminalCount = (uint32_t)gram.terminals.size();
+	header.ruleCount = (uint32_t)RuleCount(gram);
+	header.ruleSymbolCount = (uint32_t)RuleSymbolCount(gram);
+
+	std::vector<uint32_t> nameOffsets(1, 0);
+	std::string names;
+	for (ArenaVector<std::string_view>::const_iterator it = gram.nonTerminals.begin(); it != gram.nonTerminals.end(); it++) {
+		names += *it;
+		nameOffsets.push_back((uint32_t)names.size());
+	}
+	for (ArenaVector<std::string_view>::const_iterator it = gram.terminals.begin(); it != gram.terminals.end(); it++) {
+		names += *it;
+		nameOffsets.push_back((uint32_t)names.size());
+	}
+	header.nameBytes = (uint32_t)names.size();
+	names.resize(PadTo4(names.size()), '\0');
+
+	file.write((const char*)&header, sizeof(header));
+	file.write((const char*)nameOffsets.data(), nameOffsets.size() * sizeof(uint32_t));
+	file.write(names.data(), names.size());
+	file.write((const char*)RuleOffsetData(gram), (2 * RuleCount(gram) + 1) * sizeof(uint32_t));
+	file.write((const char*)RuleSymbolData(gram), RuleSymbolCount(gram) * sizeof(Symbol));
+
+	if (!file) {
+		error = "can't write \"" + path + "\"";
+		return false;
+	}
+
+	return true;
+}
+
+bool CheckBinaryGrammar(const BinaryGrammarHeader& header, const uint32_t* nameOffsets, const uint32_t* ruleOffsets, const Symbol* ruleSymbols, std::string& error) {
+	// one pass over the mapped sections without allocating, so that nothing read from a corrupted file can point outside of them later on
+	const size_t symbolCount = (size_t)header.nonTerminalCount + header.terminalCount,
+				 offsetCount = 2 * (size_t)header.ruleCount + 1;
+	if (header.grammarType > (uint32_t)GrammarType::TypeNULL) { // TypeNULL is what a grammar without rules is saved with
+		error = "the grammar type is unknown";
+		return false;
+	}
+	if (header.startingPoint != NoSymbol && (IsTerminal(header.startingPoint) || SymbolIndex(header.startingPoint) >= header.nonTerminalCount)) {
+		error = "the starting point is not a non-terminal";
+		return false;
+	}
+
+	if (nameOffsets[0] != 0 || nameOffsets[symbolCount] != header.nameBytes) {
+		error = "the name offsets are corrupted";
+		return false;
+	}
+	for (size_t i = 0; i < symbolCount; i++) {
+		if (nameOffsets[i + 1] < nameOffsets[i]) {
+			error = "the name offsets are corrupted";
+			return false;
+		}
+	}
+
+	if (ruleOffsets[0] != 0 || ruleOffsets[offsetCount - 1] != header.ruleSymbolCount) {
+		error = "the rule offsets are corrupted";
+		return false;
+	}
+	for (size_t i = 0; i + 1 < offsetCount; i++) {
+		if (ruleOffsets[i + 1] < ruleOffsets[i] || (i % 2 == 0 && ruleOffsets[i + 1] == ruleOffsets[i])) { // every left side has a symbol
+			error = "the rule offsets are corrupted";
+			return false;
+		}
+	}
+
+	for (size_t i = 0; i < header.ruleSymbolCount; i++) {
+		if (SymbolIndex(ruleSymbols[i]) >= (IsTerminal(ruleSymbols[i]) ? header.terminalCount : header.nonTerminalCount)) {
+			error = "rule symbol " + std::to_string(i) + " is not in the alphabets";
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool LoadGrammarBinary(const std::string& path, Grammar& gram, GrammarType* type, std::string& error) {
+	STAT_PHASE(StatPhase::LoadGrammar);
+	std::shared_ptr<MappedFile> mapped = MapFile(path);
+	if (!mapped) {
+		error = "can't map \"" + path + "\"";
+		return false;
+	}
+
+	BinaryGrammarHeader header;
+	if (mapped->size < sizeof(header)) {
+		error = "\"" + path + "\" is too short to be a binary grammar";
+		return false;
+	}
+
+	memcpy(&header, mapped->data, sizeof(header));
+	if (memcmp(header.magic, BinaryGrammarMagic, sizeof(header.magic)) != 0 || header.version != BinaryGrammarVersion) {
+		error = "\"" + path + "\" is not a binary grammar of version " + std::to_string(BinaryGrammarVersion);
+		return false;
+	}
+
+	// check that every section fits into the file before we point into it
+	const size_t symbolCount = (size_t)header.nonTerminalCount + header.terminalCount;
+	const size_t namesStart = sizeof(header) + (symbolCount + 1) * sizeof(uint32_t),
+				 offsetsStart = namesStart + PadTo4(header.nameBytes),
+				 symbolsStart = offsetsStart + (2 * (size_t)header.ruleCount + 1) * sizeof(uint32_t),
+				 end = symbolsStart + (size_t)header.ruleSymbolCount * sizeof(Symbol);
+	if (end != mapped->size) {
+		error = "the sections of \"" + path + "\" don't add up to its size";
+		return false;
+	}
+
+	const uint32_t* nameOffsets = (const uint32_t*)(mapped->data + sizeof(header));
+	const char* names = mapped->data + namesStart;
+	const uint32_t* ruleOffsets = (const uint32_t*)(mapped->data + offsetsStart);
+	const Symbol* ruleSymbols = (const Symbol*)(mapped->data + symbolsStart);
+	if (!CheckBinaryGrammar(header, nameOffsets, ruleOffsets, ruleSymbols, error)) {
+		error = "\"" + path + "\" is corrupted, " + error;
+		return false;
+	}
+
+	// the symbol table is the only thing we rebuild, its size depends on the alphabets and not on the rules
+	gram = Grammar();
+	for (size_t i = 0; i < symbolCount; i++) {
+		const std::string name(names + nameOffsets[i], nameOffsets[i + 1] - nameOffsets[i]);
+		if (FindSymbol(gram, name) != NoSymbol) {
+			error = "symbol \"" + name + "\" appears twice in \"" + path + "\"";
+			return false;
+		}
+
+		if (i < header.nonTerminalCount) {
+			AddNonTerminal(gram, name);
+		}
+		else {
+			AddTerminal(gram, name);
+		}
+	}
+
+	gram.startingPoint = header.startingPoint;
+	gram.mappedSymbols = ruleSymbols;
+	gram.mappedOffsets = ruleOffsets;
+	gram.mappedRuleCount = header.ruleCount;
+	gram.mappedFile = mapped;
+
+	if (type) {
+		*type = (GrammarType)header.grammarType;
+	}
+
+	return true;
+}
+
+bool IsBinaryGrammarFile(const std::string& path) {
+	std::ifstream file(path, std::ios::binary);
+	char magic[sizeof(BinaryGrammarMagic)];
+	return file.read(magic, sizeof(magic)) && memcmp(magic, BinaryGrammarMagic, sizeof(magic)) == 0;
+}
+
+bool LoadGrammarFile(const std::string& path, Grammar& gram, std::string& error, GrammarType* type = nullptr) {
+	// binary grammars are recognized by their magic, everything else is read as text
+	if (IsBinaryGrammarFile(path)) {
+		return LoadGrammarBinary(path, gram, type, error);
+	}
+
+	std::ifstream file(path, std::ios::binary);
+	if (!file) {
+		error = "can't open \"" + path + "\"";
+		return false;
+	}
+
+	if (!LoadGrammar(file, gram, error)) {
+		return false;
+	}
+
+	if (type) {
+		*type = FindGrammarType(gram);
+	}
+
+	return true;
+}
+
+bool ConvertGrammarFile(const std::string& inputPath, const std::string& outputPath, bool toBinary, std::string& error) {
+	Grammar gram;
+	if (!LoadGrammarFile(inputPath, gram, error)) {
+		return false;
+	}
+
+	if (toBinary) {
+		return SaveGrammarBinary(outputPath, gram, error);
+	}
+
+	std::ofstream file(outputPath, std::ios::binary);
+	SaveGrammar(file, gram);
+	if (!file) {
+		error = "can't write \"" + outputPath + "\"";
+		return false;
+	}
+
+	return true;
+}
+
+// Membership functions
+
+inline uint32_t LowestBit(uint64_t bits) {
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward64(&index, bits);
+	return (uint32_t)index;
+#else
+	return (uint32_t)__builtin_ctzll(bits);
+#endif
+}
+
+bool SplitWord(const Grammar& gram, std::string_view word, std::vector<Symbol>& symbols, std::string& error) {
+	// the terminals of a word can be written together or apart, "|" on its own being the empty word
+	symbols.clear();
+	size_t errorOffset = 0;
+	for (size_t start = 0; start < word.size();) {
+		if (word[start] == ' ' || word[start] == '\t') {
+			start++;
+			continue;
+		}
+
+		size_t end = start;
+		while (end < word.size() && word[end] != ' ' && word[end] != '\t') {
+			end++;
+		}
+
+		if (!SplitIntoSymbols(gram, word.substr(start, end - start), symbols, errorOffset)) {
+			error = "no terminal starts at \"" + std::string(word.substr(start + errorOffset, end - start - errorOffset)) + "\"";
+			return false;
+		}
+		start = end;
+	}
+
+	for (std::vector<Symbol>::const_iterator it = symbols.begin(); it != symbols.end(); it++) {
+		if (!IsTerminal(*it)) {
+			error = "\"" + std::string(SymbolName(gram, *it)) + "\" is a non-terminal";
+			return false;
+		}
+	}
+
+	return true;
+}
+
+const uint32_t NoCnfRow = 0xFFFFFFFFu;
+
+struct CnfGrammar { // a context-free grammar in Chomsky normal form, laid out for the CYK chart
+	// the grammar's own non-terminals keep their index and the ones made up by the conversion come after them,
+	// every set of non-terminals is a bitset of words 64-bit words
+	size_t nonTerminalCount = 0,
+		   words = 0;
+	uint32_t startingPoint = 0;
+	bool acceptsEmptyWord = false;
+
+	// the sets of heads already hold everything that reaches them through unit rules, so the chart never has to follow those
+	std::vector<uint64_t> terminalHeads; // for every terminal a, the non-terminals that derive the word a
+
+	// the binary rules A -> B C are grouped into pairs B C, one row for every B and one column for every C:
+	// the pairs of a row are pairStarts[row] .. pairStarts[row + 1], pairHeads holding the As deriving each of them
+	std::vector<uint32_t> rows, // non-terminal -> its row, NoCnfRow if it is no B
+						  columns; // the same for the Cs
+	size_t columnCount = 0;
+	std::vector<uint32_t> pairStarts,
+						  pairColumns;
+	std::vector<uint64_t> pairHeads;
+};
+
+struct CnfRule { // A -> B C
+	uint32_t left,
+			 first,
+			 second;
+};
+
+struct UnitGraph { // the unit rules A -> B, parents[starts[B] .. starts[B + 1]) being every such A
+	std::vector<uint32_t> starts,
+						  parents;
+};
+
+void AddWithUnitParents(const UnitGraph& units, uint32_t nonTerminal, uint64_t* set, std::vector<uint32_t>& stack) {
+	// adds the non-terminal and everything deriving it through unit rules alone, what is in the set already has its parents too
+	stack.assign(1, nonTerminal);
+	while (!stack.empty()) {
+		const uint32_t current = stack.back();
+		stack.pop_back();
+		if (set[current / 64] & ((uint64_t)1 << (current % 64))) {
+			continue;
+		}
+
+		set[current / 64] |= (uint64_t)1 << (current % 64);
+		stack.insert(stack.end(), units.parents.begin() + units.starts[current], units.parents.begin() + units.starts[current + 1]);
+	}
+}
+
+bool BuildCnf(const Grammar& gram, CnfGrammar& cnf, std::string& error) {
+	const GrammarType type = FindGrammarType(gram);
+	if (type != GrammarType::Type2 && type != GrammarType::Type3) {
+		error = "CYK needs a grammar of type 2 or 3";
+		return false;
+	}
+	if (gram.startingPoint == NoSymbol) {
+		error = "the grammar has no starting point";
+		return false;
+	}
+
+	// the empty word rules are left out, the nullable set brings back what they derive
+	const std::vector<uint64_t> nullableSet = FindNullableNonTerminals(gram);
+	std::vector<uint8_t> nullable(gram.nonTerminals.size(), 0); // grows with the made up non-terminals below
+	for (uint32_t i = 0; i < (uint32_t)nullable.size(); i++) {
+		nullable[i] = HasBit(nullableSet, i) ? 1 : 0;
+	}
+	std::vector<uint32_t> terminalStandIns(gram.terminals.size(), NoCnfRow); // the made up T -> a that takes the place of a in longer rules
+	std::vector<std::pair<uint32_t, uint32_t>> terminalRules, // (a, A) for A -> a
+											   unitRules; // (B, A) for A -> B
+	std::vector<CnfRule> binaryRules;
+	std::vector<uint32_t> right;
+	uint32_t nonTerminalCount = (uint32_t)gram.nonTerminals.size();
+	for (size_t i = 0; i < RuleCount(gram); i++) {
+		RuleView rule = GetRule(gram, i);
+		const uint32_t left = SymbolIndex(rule.left[0]);
+		if (rule.rightLength == 1) {
+			if (IsTerminal(rule.right[0])) {
+				terminalRules.push_back(std::make_pair(SymbolIndex(rule.right[0]), left));
+			}
+			else if (SymbolIndex(rule.right[0]) != left) {
+				unitRules.push_back(std::make_pair(SymbolIndex(rule.right[0]), left));
+			}
+			continue;
+		}
+		if (rule.rightLength == 0) {
+			continue;
+		}
+
+		right.clear();
+		for (uint32_t j = 0; j < rule.rightLength; j++) {
+			if (!IsTerminal(rule.right[j])) {
+				right.push_back(SymbolIndex(rule.right[j]));
+				continue;
+			}
+
+			uint32_t& standIn = terminalStandIns[SymbolIndex(rule.right[j])];
+			if (standIn == NoCnfRow) {
+				standIn = nonTerminalCount++;
+				nullable.push_back(0);
+				terminalRules.push_back(std::make_pair(SymbolIndex(rule.right[j]), standIn));
+			}
+			right.push_back(standIn);
+		}
+
+		// A -> Y1 Z1, Z1 -> Y2 Z2, ..., the made up Zs being nullable when everything they stand for is
+		uint32_t last = right.back();
+		for (size_t j = right.size() - 2; j > 0; j--) {
+			const uint32_t madeUp = nonTerminalCount++;
+			nullable.push_back(nullable[right[j]] && nullable[last]);
+			binaryRules.push_back(CnfRule{ madeUp, right[j], last });
+			last = madeUp;
+		}
+		binaryRules.push_back(CnfRule{ left, right[0], last });
+	}
+
+	// with the empty word rules gone, A -> B C with a nullable C also derives what B does on its own
+	for (std::vector<CnfRule>::const_iterator it = binaryRules.begin(); it != binaryRules.end(); it++) {
+		if (nullable[it->second] && it->first != it->left) {
+			unitRules.push_back(std::make_pair(it->first, it->left));
+		}
+		if (nullable[it->first] && it->second != it->left) {
+			unitRules.push_back(std::make_pair(it->second, it->left));
+		}
+	}
+
+	UnitGraph units;
+	units.starts.assign(nonTerminalCount + 1, 0);
+	units.parents.resize(unitRules.size());
+	for (size_t i = 0; i < unitRules.size(); i++) {
+		units.starts[unitRules[i].first + 1]++;
+	}
+	for (size_t i = 1; i < units.starts.size(); i++) {
+		units.starts[i] += units.starts[i - 1];
+	}
+	std::vector<uint32_t> fill(units.starts.begin(), units.starts.end() - 1);
+	for (size_t i = 0; i < unitRules.size(); i++) {
+		units.parents[fill[unitRules[i].first]++] = unitRules[i].second;
+	}
+
+	cnf = CnfGrammar();
+	cnf.nonTerminalCount = nonTerminalCount;
+	cnf.words = (nonTerminalCount + 63) / 64;
+	cnf.startingPoint = SymbolIndex(gram.startingPoint);
+	cnf.acceptsEmptyWord = nullable[cnf.startingPoint] != 0;
+
+	std::vector<uint32_t> stack;
+	cnf.terminalHeads.assign(gram.terminals.size() * cnf.words, 0);
+	for (size_t i = 0; i < terminalRules.size(); i++) {
+		AddWithUnitParents(units, terminalRules[i].second, &cnf.terminalHeads[terminalRules[i].first * cnf.words], stack);
+	}
+
+	std::sort(binaryRules.begin(), binaryRules.end(), [](const CnfRule& rule1, const CnfRule& rule2) {
+		return (rule1.first != rule2.first) ? rule1.first < rule2.first : rule1.second < rule2.second;
+	});
+	cnf.rows.assign(nonTerminalCount, NoCnfRow);
+	cnf.columns.assign(nonTerminalCount, NoCnfRow);
+	for (size_t i = 0; i < binaryRules.size(); i++) {
+		const CnfRule& rule = binaryRules[i];
+		if (i == 0 || rule.first != binaryRules[i - 1].first) { // a new row
+			cnf.rows[rule.first] = (uint32_t)cnf.pairStarts.size();
+			cnf.pairStarts.push_back((uint32_t)cnf.pairColumns.size());
+		}
+		if (i == 0 || rule.first != binaryRules[i - 1].first || rule.second != binaryRules[i - 1].second) { // a new pair in the row
+			if (cnf.columns[rule.second] == NoCnfRow) {
+				cnf.columns[rule.second] = (uint32_t)cnf.columnCount++;
+			}
+			cnf.pairColumns.push_back(cnf.columns[rule.second]);
+			cnf.pairHeads.resize(cnf.pairHeads.size() + cnf.words, 0);
+		}
+
+		AddWithUnitParents(units, rule.left, &cnf.pairHeads[cnf.pairHeads.size() - cnf.words], stack);
+	}
+	cnf.pairStarts.push_back((uint32_t)cnf.pairColumns.size());
+
+	return true;
+}
+
+struct CykChart { // which spans every B and every C of the binary rules derive, as bitsets over the positions of the word
+	size_t positionWords = 0;
+	std::vector<uint64_t> ends, // row, start -> the ends of the spans that B derives from there
+						  starts; // column, end -> the starts of the spans that C derives up to there
+};
+
+void AddToChart(const CnfGrammar& cnf, CykChart& chart, const uint64_t* cell, size_t start, size_t end, size_t length) {
+	// records the non-terminals of the cell for the longer spans built on top of it
+	for (size_t w = 0; w < cnf.words; w++) {
+		for (uint64_t bits = cell[w]; bits != 0; bits &= bits - 1) {
+			const size_t nonTerminal = w * 64 + LowestBit(bits);
+			if (cnf.rows[nonTerminal] != NoCnfRow) {
+				chart.ends[(cnf.rows[nonTerminal] * (length + 1) + start) * chart.positionWords + end / 64] |= (uint64_t)1 << (end % 64);
+			}
+			if (cnf.columns[nonTerminal] != NoCnfRow) {
+				chart.starts[(cnf.columns[nonTerminal] * (length + 1) + end) * chart.positionWords + start / 64] |= (uint64_t)1 << (start % 64);
+			}
+		}
+	}
+}
+
+bool RecognizeCyk(const CnfGrammar& cnf, const Symbol* word, size_t length) {
+	// the cell of a span is the set of non-terminals deriving it, B C adds its heads when some split point k has B deriving
+	// [start, k) and C deriving [k, end), which is an AND over 64 split points at a time
+	if (length == 0) {
+		return cnf.acceptsEmptyWord;
+	}
+
+	const size_t words = cnf.words,
+				 rowCount = cnf.pairStarts.size() - 1;
+	CykChart chart;
+	chart.positionWords = (length + 1 + 63) / 64;
+	chart.ends.assign(rowCount * (length + 1) * chart.positionWords, 0);
+	chart.starts.assign(cnf.columnCount * (length + 1) * chart.positionWords, 0);
+
+	std::vector<uint64_t> cell(words);
+	for (size_t i = 0; i < length; i++) {
+		const uint64_t* heads = &cnf.terminalHeads[SymbolIndex(word[i]) * words];
+		if (length == 1) {
+			return (heads[cnf.startingPoint / 64] & ((uint64_t)1 << (cnf.startingPoint % 64))) != 0;
+		}
+		AddToChart(cnf, chart, heads, i, i + 1, length);
+	}
+
+	for (size_t spanLength = 2; spanLength <= length; spanLength++) {
+		for (size_t start = 0; start + spanLength <= length; start++) {
+			const size_t end = start + spanLength,
+						 firstWord = (start + 1) / 64,
+						 lastWord = (end - 1) / 64;
+			std::fill(cell.begin(), cell.end(), 0);
+			for (size_t row = 0; row < rowCount; row++) {
+				const uint64_t* ends = &chart.ends[(row * (length + 1) + start) * chart.positionWords];
+				for (uint32_t pair = cnf.pairStarts[row]; pair < cnf.pairStarts[row + 1]; pair++) {
+					const uint64_t* heads = &cnf.pairHeads[(size_t)pair * words];
+					bool known = true; // nothing to win from this pair if the cell already has all of its heads
+					for (size_t w = 0; w < words && known; w++) {
+						known = (heads[w] & ~cell[w]) == 0;
+					}
+					if (known) {
+						continue;
+					}
+
+					const uint64_t* starts = &chart.starts[(cnf.pairColumns[pair] * (length + 1) + end) * chart.positionWords];
+					bool joined = false;
+					for (size_t w = firstWord; w <= lastWord && !joined; w++) {
+						joined = (ends[w] & starts[w]) != 0;
+					}
+					if (joined) {
+						for (size_t w = 0; w < words; w++) {
+							cell[w] |= heads[w];
+						}
+					}
+				}
+			}
+
+			if (spanLength == length) {
+				return (cell[cnf.startingPoint / 64] & ((uint64_t)1 << (cnf.startingPoint % 64))) != 0;
+			}
+			AddToChart(cnf, chart, cell.data(), start, end, length);
+		}
+	}
+
+	return false;
+}
+
+const uint32_t NoEarleyItem = 0xFFFFFFFFu;
+
+struct EarleyGrammar { // what the Earley functions need to know about a context-free grammar, built once for any number of words
+	std::vector<uint32_t> ruleStarts, // the rules of non-terminal n are rules[ruleStarts[n] .. ruleStarts[n + 1])
+						  rules;
+	std::vector<uint64_t> nullable; // a bitset over the non-terminals
+	std::vector<uint32_t> emptyRules; // for every nullable non-terminal, a rule that derives the empty word without going round in circles
+	Symbol startingPoint = NoSymbol;
+};
+
+struct EarleyItem { // a rule with the dot before right[dot], started at position origin
+	uint32_t rule,
+			 dot,
+			 origin;
+};
+
+enum class EarleyStep : uint8_t { // how an item first got into its set
+	Predict,
+	Scan, // from the item before it in the previous set
+	Complete, // from a waiting item of the child's origin set and the completed child in this set
+	SkipEmpty, // from the item before it in this set, over a nullable non-terminal
+	Leo // the top of a Leo chain, from the completed item at its bottom in this set
+};
+
+struct EarleyLink { // what the parse tree needs to take an item apart again
+	EarleyStep step;
+	uint32_t predecessor,
+			 child;
+};
+
+struct EarleyTransition { // the items of a finished set that wait for one non-terminal
+	Symbol nonTerminal;
+	uint32_t first, // into EarleySet::waiting
+			 count;
+	EarleyItem leo; // if Leo's optimization applies, the topmost completed item that completing the non-terminal leads to
+};
+
+struct EarleySet { // the items of one position, kept unique through an open addressing table of item indices
+	ArenaVector<EarleyItem> items;
+	ArenaVector<EarleyLink> links; // one for every item, the first way it was made
+	ArenaVector<uint32_t> slots; // NoEarleyItem marks a free slot
+	ArenaVector<EarleyTransition> transitions; // sorted by non-terminal, filled once the set is finished
+	ArenaVector<uint32_t> waiting;
+
+	EarleySet(const std::shared_ptr<Arena>& arena) : items(arena), links(arena), slots(arena), transitions(arena), waiting(arena) {}
+};
+
+struct EarleyChart { // all the sets of one word live in the chart's arena and go away together
+	std::shared_ptr<Arena> arena = std::make_shared<Arena>();
+	std::vector<EarleySet> sets;
+};
+
+bool BuildEarley(const Grammar& gram, EarleyGrammar& earley, std::string& error) {
+	const GrammarType type = FindGrammarType(gram);
+	if (type != GrammarType::Type2 && type != GrammarType::Type3) {
+		error = "Earley needs a grammar of type 2 or 3";
+		return false;
+	}
+	if (gram.startingPoint == NoSymbol) {
+		error = "the grammar has no starting point";
+		return false;
+	}
+
+	earley = EarleyGrammar();
+	earley.startingPoint = gram.startingPoint;
+	earley.nullable = FindNullableNonTerminals(gram, &earley.emptyRules);
+	earley.ruleStarts.assign(gram.nonTerminals.size() + 1, 0);
+	earley.rules.resize(RuleCount(gram));
+	for (size_t i = 0; i < RuleCount(gram); i++) {
+		earley.ruleStarts[SymbolIndex(GetRule(gram, i).left[0]) + 1]++;
+	}
+	for (size_t i = 1; i < earley.ruleStarts.size(); i++) {
+		earley.ruleStarts[i] += earley.ruleStarts[i - 1];
+	}
+	std::vector<uint32_t> fill(earley.ruleStarts.begin(), earley.ruleStarts.end() - 1);
+	for (size_t i = 0; i < RuleCount(gram); i++) {
+		earley.rules[fill[SymbolIndex(GetRule(gram, i).left[0])]++] = (uint32_t)i;
+	}
+
+	return true;
+}
+
+inline size_t EarleySlot(const EarleyItem& item, size_t mask) {
+	const uint64_t hash = ((uint64_t)item.rule * 0x9E3779B97F4A7C15ull) ^ ((uint64_t)item.dot * 0xC2B2AE3D27D4EB4Full) ^ ((uint64_t)item.origin * 0x165667B19E3779F9ull);
+	return (size_t)(hash ^ (hash >> 29)) & mask;
+}
+
+uint32_t FindEarleyItem(const EarleySet& set, const EarleyItem& item) {
+	if (set.slots.empty()) {
+		return NoEarleyItem;
+	}
+
+	const size_t mask = set.slots.size() - 1;
+	for (size_t slot = EarleySlot(item, mask); set.slots[slot] != NoEarleyItem; slot = (slot + 1) & mask) {
+		const EarleyItem& found = set.items[set.slots[slot]];
+		if (found.rule == item.rule && found.dot == item.dot && found.origin == item.origin) {
+			return set.slots[slot];
+		}
+	}
+
+	return NoEarleyItem;
+}
+
+void AddEarleyItem(EarleySet& set, const EarleyItem& item, EarleyStep step, uint32_t predecessor = NoEarleyItem, uint32_t child = NoEarleyItem) {
+	if (2 * (set.items.size() + 1) > set.slots.size()) { // keeps the table at most half full
+		set.slots.assign(std::max<size_t>(16, 2 * set.slots.size()), NoEarleyItem);
+		const size_t mask = set.slots.size() - 1;
+		for (size_t i = 0; i < set.items.size(); i++) {
+			size_t slot = EarleySlot(set.items[i], mask);
+			while (set.slots[slot] != NoEarleyItem) {
+				slot = (slot + 1) & mask;
+			}
+			set.slots[slot] = (uint32_t)i;
+		}
+	}
+
+	const size_t mask = set.slots.size() - 1;
+	size_t slot = EarleySlot(item, mask);
+	for (; set.slots[slot] != NoEarleyItem; slot = (slot + 1) & mask) {
+		const EarleyItem& found = set.items[set.slots[slot]];
+		if (found.rule == item.rule && found.dot == item.dot && found.origin == item.origin) {
+			return;
+		}
+	}
+
+	set.slots[slot] = (uint32_t)set.items.size();
+	set.items.push_back(item);
+	set.links.push_back(EarleyLink{ step, predecessor, child });
+}
+
+const EarleyTransition* FindTransition(const EarleySet& set, Symbol nonTerminal) {
+	ArenaVector<EarleyTransition>::const_iterator found = std::lower_bound(set.transitions.begin(), set.transitions.end(), nonTerminal,
+		[](const EarleyTransition& transition, Symbol symbol) { return transition.nonTerminal < symbol; });
+	return (found != set.transitions.end() && found->nonTerminal == nonTerminal) ? &*found : nullptr;
+}
+
+void FinishEarleySet(const Grammar& gram, std::vector<EarleySet>& sets, size_t position, std::vector<std::pair<Symbol, uint32_t>>& scratch) {
+	// groups the items by the non-terminal after their dot, so completing one only looks at the items waiting for it
+	EarleySet& set = sets[position];
+	scratch.clear();
+	for (size_t i = 0; i < set.items.size(); i++) {
+		RuleView rule = GetRule(gram, set.items[i].rule);
+		if (set.items[i].dot < rule.rightLength && !IsTerminal(rule.right[set.items[i].dot])) {
+			scratch.push_back(std::make_pair(rule.right[set.items[i].dot], (uint32_t)i));
+		}
+	}
+	std::sort(scratch.begin(), scratch.end());
+
+	set.waiting.reserve(scratch.size());
+	for (size_t i = 0; i < scratch.size(); i++) {
+		if (i == 0 || scratch[i].first != scratch[i - 1].first) {
+			EarleyTransition transition;
+			transition.nonTerminal = scratch[i].first;
+			transition.first = (uint32_t)i;
+			transition.count = 0;
+			transition.leo.rule = NoEarleyItem;
+			set.transitions.push_back(transition);
+		}
+		set.transitions.back().count++;
+		set.waiting.push_back(scratch[i].second);
+	}
+
+	// Leo: when a single item A -> a.B waits for B, completing B only completes A in turn, so we jump straight to the top
+	// of that chain, which keeps right recursion linear; items from this very set are left out so the chains can't loop
+	for (ArenaVector<EarleyTransition>::iterator it = set.transitions.begin(); it != set.transitions.end(); it++) {
+		const EarleyItem& item = set.items[set.waiting[it->first]];
+		RuleView rule = GetRule(gram, item.rule);
+		if (it->count != 1 || item.dot + 1 != rule.rightLength || item.origin == position) {
+			continue;
+		}
+
+		const EarleyTransition* above = FindTransition(sets[item.origin], rule.left[0]);
+		if (above && above->leo.rule != NoEarleyItem) {
+			it->leo = above->leo;
+		}
+		else {
+			it->leo = EarleyItem{ item.rule, item.dot + 1, item.origin };
+		}
+	}
+}
+
+bool FillEarleyChart(const Grammar& gram, const EarleyGrammar& earley, const Symbol* word, size_t length, EarleyChart& chart) {
+	// the nullable non-terminals are skipped over as soon as they are predicted (Aycock and Horspool), so an item completed
+	// in the set it started in never has to complete anything
+	chart.sets.clear();
+	chart.sets.reserve(length + 1);
+	for (size_t i = 0; i <= length; i++) {
+		chart.sets.emplace_back(chart.arena);
+	}
+
+	const uint32_t start = SymbolIndex(earley.startingPoint);
+	for (uint32_t i = earley.ruleStarts[start]; i < earley.ruleStarts[start + 1]; i++) {
+		AddEarleyItem(chart.sets[0], EarleyItem{ earley.rules[i], 0, 0 }, EarleyStep::Predict);
+	}
+
+	std::vector<uint32_t> predictedAt(earley.emptyRules.size(), NoEarleyItem); // the last set each non-terminal was predicted in
+	std::vector<std::pair<Symbol, uint32_t>> scratch;
+	for (size_t position = 0; position <= length; position++) {
+		EarleySet& set = chart.sets[position];
+		for (size_t next = 0; next < set.items.size(); next++) {
+			const EarleyItem item = set.items[next];
+			RuleView rule = GetRule(gram, item.rule);
+			if (item.dot == rule.rightLength) {
+				if (item.origin == position) {
+					continue;
+				}
+
+				const EarleyTransition* transition = FindTransition(chart.sets[item.origin], rule.left[0]);
+				if (!transition) {
+					continue;
+				}
+				if (transition->leo.rule != NoEarleyItem) {
+					AddEarleyItem(set, transition->leo, EarleyStep::Leo, NoEarleyItem, (uint32_t)next);
+					continue;
+				}
+
+				const EarleySet& from = chart.sets[item.origin];
+				for (uint32_t i = transition->first; i < transition->first + transition->count; i++) {
+					const EarleyItem& waiting = from.items[from.waiting[i]];
+					AddEarleyItem(set, EarleyItem{ waiting.rule, waiting.dot + 1, waiting.origin }, EarleyStep::Complete, from.waiting[i], (uint32_t)next);
+				}
+				continue;
+			}
+
+			const Symbol symbol = rule.right[item.dot];
+			if (IsTerminal(symbol)) {
+				if (position < length && word[position] == symbol) {
+					AddEarleyItem(chart.sets[position + 1], EarleyItem{ item.rule, item.dot + 1, item.origin }, EarleyStep::Scan, (uint32_t)next);
+				}
+				continue;
+			}
+
+			const uint32_t nonTerminal = SymbolIndex(symbol);
+			if (predictedAt[nonTerminal] != position) {
+				predictedAt[nonTerminal] = (uint32_t)position;
+				for (uint32_t i = earley.ruleStarts[nonTerminal]; i < earley.ruleStarts[nonTerminal + 1]; i++) {
+					AddEarleyItem(set, EarleyItem{ earley.rules[i], 0, (uint32_t)position }, EarleyStep::Predict);
+				}
+			}
+			if (HasBit(earley.nullable, nonTerminal)) {
+				AddEarleyItem(set, EarleyItem{ item.rule, item.dot + 1, item.origin }, EarleyStep::SkipEmpty, (uint32_t)next);
+			}
+		}
+
+		if (position < length && chart.sets[position + 1].items.empty()) { // nothing got past this symbol
+			return false;
+		}
+		FinishEarleySet(gram, chart.sets, position, scratch);
+	}
+
+	for (uint32_t i = earley.ruleStarts[start]; i < earley.ruleStarts[start + 1]; i++) {
+		const uint32_t rule = earley.rules[i];
+		if (FindEarleyItem(chart.sets[length], EarleyItem{ rule, GetRule(gram, rule).rightLength, 0 }) != NoEarleyItem) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool RecognizeEarley(const Grammar& gram, const EarleyGrammar& earley, const Symbol* word, size_t length) {
+	EarleyChart chart;
+	return FillEarleyChart(gram, earley, word, length, chart);
+}
+
+struct ParseNode {
+	Symbol symbol;
+	uint32_t rule, // NoRule for terminals
+			 firstChild, // into ParseTree::children, one slot for every symbol on the right side of the rule
+			 childCount;
+};
+
+struct ParseTree {
+	std::vector<ParseNode> nodes;
+	std::vector<uint32_t> children;
+	uint32_t root = 0;
+};
+
+struct ParseTask { // fill the first dot children of a node by taking an item apart
+	uint32_t set,
+			 item,
+			 node;
+};
+
+uint32_t AddParseNode(ParseTree& tree, Symbol symbol, uint32_t rule, uint32_t childCount) {
+	ParseNode node;
+	node.symbol = symbol;
+	node.rule = rule;
+	node.firstChild = (uint32_t)tree.children.size();
+	node.childCount = childCount;
+	tree.children.resize(tree.children.size() + childCount);
+
+	tree.nodes.push_back(node);
+	return (uint32_t)tree.nodes.size() - 1;
+}
+
+uint32_t AddEmptyParse(const Grammar& gram, const EarleyGrammar& earley, ParseTree& tree, Symbol nonTerminal) {
+	// only as deep as there are non-terminals, the empty rules never go round in circles
+	const uint32_t rule = earley.emptyRules[SymbolIndex(nonTerminal)];
+	RuleView view = GetRule(gram, rule);
+	const uint32_t node = AddParseNode(tree, nonTerminal, rule, view.rightLength);
+	for (uint32_t i = 0; i < view.rightLength; i++) {
+		const uint32_t child = AddEmptyParse(gram, earley, tree, view.right[i]);
+		tree.children[tree.nodes[node].firstChild + i] = child;
+	}
+
+	return node;
+}
+
+uint32_t AddCompletedParse(const Grammar& gram, const EarleyChart& chart, uint32_t set, uint32_t item, ParseTree& tree, std::vector<ParseTask>& tasks) {
+	const uint32_t rule = chart.sets[set].items[item].rule;
+	RuleView view = GetRule(gram, rule);
+	const uint32_t node = AddParseNode(tree, view.left[0], rule, view.rightLength);
+	tasks.push_back(ParseTask{ set, item, node });
+	return node;
+}
+
+void TakeItemApart(const Grammar& gram, const EarleyGrammar& earley, const EarleyChart& chart, ParseTask task, ParseTree& tree, std::vector<ParseTask>& tasks) {
+	// walks the links of the item back to the start of its rule, one child for every step; a link always points to an item
+	// made before, so this never loops, and the children that need taking apart themselves are left to the tasks
+	while (chart.sets[task.set].items[task.item].dot > 0) {
+		const EarleySet& set = chart.sets[task.set];
+		const EarleyItem item = set.items[task.item];
+		const EarleyLink link = set.links[task.item];
+		const uint32_t slot = tree.nodes[task.node].firstChild + item.dot - 1;
+		const Symbol symbol = GetRule(gram, item.rule).right[item.dot - 1];
+		switch (link.step) {
+			case EarleyStep::Scan: {
+				const uint32_t leaf = AddParseNode(tree, symbol, NoRule, 0);
+				tree.children[slot] = leaf;
+				task.set--;
+				task.item = link.predecessor;
+				break;
+			}
+			case EarleyStep::SkipEmpty: {
+				const uint32_t child = AddEmptyParse(gram, earley, tree, symbol);
+				tree.children[slot] = child;
+				task.item = link.predecessor;
+				break;
+			}
+			case EarleyStep::Complete: {
+				const uint32_t child = AddCompletedParse(gram, chart, task.set, link.child, tree, tasks);
+				tree.children[slot] = child;
+				task.set = set.items[link.child].origin;
+				task.item = link.predecessor;
+				break;
+			}
+			case EarleyStep::Leo: {
+				// the items between the completed one at the bottom and this one at the top were never added, so we walk the
+				// chain up again: every item waiting on the way completes with the one below as its last child
+				uint32_t below = AddCompletedParse(gram, chart, task.set, link.child, tree, tasks);
+				const EarleyItem& bottom = set.items[link.child];
+				uint32_t waitingSet = bottom.origin;
+				const EarleyTransition* transition = FindTransition(chart.sets[waitingSet], GetRule(gram, bottom.rule).left[0]);
+				for (;;) {
+					const uint32_t waitingItem = chart.sets[waitingSet].waiting[transition->first];
+					const EarleyItem& waiting = chart.sets[waitingSet].items[waitingItem];
+					const EarleyTransition* above = FindTransition(chart.sets[waiting.origin], GetRule(gram, waiting.rule).left[0]);
+					if (!above || above->leo.rule == NoEarleyItem) { // the waiting item completes into this one
+						tree.children[slot] = below;
+						task.set = waitingSet;
+						task.item = waitingItem;
+						break;
+					}
+
+					RuleView view = GetRule(gram, waiting.rule);
+					const uint32_t node = AddParseNode(tree, view.left[0], waiting.rule, view.rightLength);
+					tree.children[tree.nodes[node].firstChild + view.rightLength - 1] = below;
+					tasks.push_back(ParseTask{ waitingSet, waitingItem, node });
+					below = node;
+					waitingSet = waiting.origin;
+					transition = above;
+				}
+				break;
+			}
+			case EarleyStep::Predict: {
+				return; // only items with the dot at the start are predicted
+			}
+		}
+	}
+}
+
+bool ParseEarley(const Grammar& gram, const EarleyGrammar& earley, const Symbol* word, size_t length, ParseTree& tree) {
+	// the tree is built from the links of the items, with a stack of tasks instead of recursion so deep trees are fine
+	EarleyChart chart;
+	if (!FillEarleyChart(gram, earley, word, length, chart)) {
+		return false;
+	}
+
+	tree = ParseTree();
+	std::vector<ParseTask> tasks;
+	const uint32_t start = SymbolIndex(earley.startingPoint);
+	for (uint32_t i = earley.ruleStarts[start]; i < earley.ruleStarts[start + 1]; i++) {
+		const uint32_t rule = earley.rules[i];
+		const uint32_t item = FindEarleyItem(chart.sets[length], EarleyItem{ rule, GetRule(gram, rule).rightLength, 0 });
+		if (item != NoEarleyItem) {
+			tree.root = AddCompletedParse(gram, chart, (uint32_t)length, item, tree, tasks);
+			break;
+		}
+	}
+
+	while (!tasks.empty()) {
+		const ParseTask task = tasks.back();
+		tasks.pop_back();
+		TakeItemApart(gram, earley, chart, task, tree, tasks);
+	}
+
+	return true;
+}
+
+void PrintParseTree(std::ostream& output, const Grammar& gram, const ParseTree& tree) {
+	// a non-terminal is followed by its children in brackets, S(a S() b)
+	std::vector<std::pair<uint32_t, uint32_t>> stack(1, std::make_pair(tree.root, 0)); // node, children printed so far
+	while (!stack.empty()) {
+		const ParseNode& node = tree.nodes[stack.back().first];
+		uint32_t& printed = stack.back().second;
+		if (printed == 0) {
+			output << SymbolName(gram, node.symbol);
+			if (node.rule == NoRule) {
+				stack.pop_back();
+				continue;
+			}
+			output << '(';
+		}
+
+		if (printed == node.childCount) {
+			output << ')';
+			stack.pop_back();
+			continue;
+		}
+
+		if (printed > 0) {
+			output << ' ';
+		}
+		const uint32_t child = tree.children[node.firstChild + printed++];
+		stack.push_back(std::make_pair(child, 0));
+	}
+}
+
+struct SearchLimits;
+void DeriveWords(const Grammar& gram, char* const* words, int wordCount, bool printDerivations, const SearchLimits* limits = nullptr, unsigned jobs = 0); // see the derivation search functions
+
+int RunMembership(int argc, char* argv[]) {
+	// main --member [--earley] <grammar file> <word>...: whether every word belongs to the language of the grammar
+	// main --parse <grammar file> <word>...: the same, with a parse tree for the words that do
+	const bool parse = strcmp(argv[1], "--parse") == 0,
+			   earley = parse || strcmp(argv[2], "--earley") == 0;
+	const int firstArgument = (earley && !parse) ? 3 : 2;
+	if (argc <= firstArgument) {
+		std::cerr << "usage: " << argv[0] << " --member [--earley] <grammar file> <word>...\n"
+				  << "       " << argv[0] << " --parse <grammar file> <word>...\n";
+		return 1;
+	}
+
+	Grammar gram;
+	CnfGrammar cnf;
+	EarleyGrammar earleyGram;
+	std::string error;
+	if (!LoadGrammarFile(argv[firstArgument], gram, error)) {
+		std::cerr << error << '\n';
+		return 1;
+	}
+
+	const GrammarType type = FindGrammarType(gram);
+	if (type == GrammarType::Type1 || type == GrammarType::Type0) { // no parser for these, so we look for a derivation
+		DeriveWords(gram, argv + firstArgument + 1, argc - firstArgument - 1, parse);
+		return 0;
+	}
+
+	if (!(earley ? BuildEarley(gram, earleyGram, error) : BuildCnf(gram, cnf, error))) {
+		std::cerr << error << '\n';
+		return 1;
+	}
+
+	std::vector<Symbol> word;
+	ParseTree tree;
+	for (int i = firstArgument + 1; i < argc; i++) {
+		std::cout << argv[i] << ": ";
+		if (!SplitWord(gram, argv[i], word, error)) {
+			std::cout << error << '\n';
+		}
+		else if (parse) {
+			if (ParseEarley(gram, earleyGram, word.data(), word.size(), tree)) {
+				PrintParseTree(std::cout, gram, tree);
+				std::cout << '\n';
+			}
+			else {
+				std::cout << "no\n";
+			}
+		}
+		else {
+			const bool member = earley ? RecognizeEarley(gram, earleyGram, word.data(), word.size()) : RecognizeCyk(cnf, word.data(), word.size());
+			std::cout << (member ? "yes" : "no") << '\n';
+		}
+	}
+
+	return 0;
+}
+
+// Automaton functions
+
+const uint32_t DeadState = 0; // the state every automaton goes to once no word can be accepted anymore, it never leaves it
+const uint32_t EpsilonColumn = 0xFFFFFFFFu;
+const size_t MaxDfaStates = 1 << 20; // subset construction can blow up exponentially, so we give up after this many states
+
+struct NfaEdge {
+	uint32_t from,
+			 column, // the index of a terminal, or EpsilonColumn
+			 to;
+};
+
+struct Nfa {
+	uint32_t stateCount = 0,
+			 start = 0;
+	std::vector<uint8_t> accepting;
+	std::vector<uint32_t> edgeStarts, // the edges of state s are edgeColumns and edgeTargets[edgeStarts[s] .. edgeStarts[s + 1])
+						  edgeColumns,
+						  edgeTargets;
+};
+
+struct Dfa { // a dense transition table, row s being where state s goes for every column
+	uint32_t stateCount = 0,
+			 columnCount = 0, // a column for every terminal, then SkipColumn and OtherColumn
+			 start = DeadState;
+	std::vector<uint32_t> transitions;
+	std::vector<uint8_t> accepting;
+	std::vector<uint32_t> characterColumns; // when every terminal is a single character, the column of every byte, so text can be matched as it is
+};
+
+inline uint32_t SkipColumn(const Dfa& dfa) { // blanks and "|", every state stays where it is
+	return dfa.columnCount - 2;
+}
+
+inline uint32_t OtherColumn(const Dfa& dfa) { // anything that isn't a terminal, every state goes to DeadState
+	return dfa.columnCount - 1;
+}
+
+void AddNfaChain(std::vector<NfaEdge>& edges, uint32_t& stateCount, uint32_t from, const Symbol* terminals, uint32_t length, uint32_t to) {
+	// goes from one state to the other by reading the terminals one after another, through fresh states in between
+	if (length == 0) {
+		edges.push_back(NfaEdge{ from, EpsilonColumn, to });
+		return;
+	}
+
+	for (uint32_t i = 0; i < length; i++) {
+		const uint32_t next = (i + 1 == length) ? to : stateCount++;
+		edges.push_back(NfaEdge{ from, SymbolIndex(terminals[i]), next });
+		from = next;
+	}
+}
+
+bool BuildNfa(const Grammar& gram, Nfa& nfa, std::string& error) {
+	if (gram.startingPoint == NoSymbol) {
+		error = "the grammar has no starting point";
+		return false;
+	}
+
+	// every rule has to have the shape IsType3 asks for, but empty word rules are fine anywhere, an automaton doesn't mind them,
+	// so the union, product and closure of type 3 grammars can be turned into one even when they come out as type 2.
+	// IsType3 also lets N -> T* N and N -> N T* rules through side by side, but only one of the two kinds makes a regular language
+	const RightSideCounts noOccurrences; // so IsType3 only looks at the shape
+	bool rightLinear = false, leftLinear = false;
+	for (size_t i = 0; i < RuleCount(gram); i++) {
+		RuleView rule = GetRule(gram, i);
+		if (!IsType3(rule, noOccurrences)) {
+			error = "only a grammar of right-linear or left-linear rules can be turned into an automaton";
+			return false;
+		}
+		if (rule.rightLength > 1 && !IsTerminal(rule.right[rule.rightLength - 1])) {
+			rightLinear = true;
+		}
+		else if (rule.rightLength > 1 && !IsTerminal(rule.right[0])) {
+			leftLinear = true;
+		}
+	}
+	if (rightLinear && leftLinear) {
+		error = "the grammar mixes right-linear and left-linear rules";
+		return false;
+	}
+
+	// every non-terminal is a state, plus one more that is the final state of a right-linear grammar,
+	// and the start of a left-linear one, which reads its rules backwards and ends in the starting point
+	const uint32_t outside = (uint32_t)gram.nonTerminals.size();
+	uint32_t stateCount = outside + 1;
+	std::vector<NfaEdge> edges;
+	for (size_t i = 0; i < RuleCount(gram); i++) {
+		RuleView rule = GetRule(gram, i);
+		const uint32_t head = SymbolIndex(rule.left[0]);
+		if (!leftLinear) {
+			if (rule.rightLength > 0 && !IsTerminal(rule.right[rule.rightLength - 1])) {
+				AddNfaChain(edges, stateCount, head, rule.right, rule.rightLength - 1, SymbolIndex(rule.right[rule.rightLength - 1]));
+			}
+			else {
+				AddNfaChain(edges, stateCount, head, rule.right, rule.rightLength, outside);
+			}
+		}
+		else {
+			if (rule.rightLength > 0 && !IsTerminal(rule.right[0])) {
+				AddNfaChain(edges, stateCount, SymbolIndex(rule.right[0]), rule.right + 1, rule.rightLength - 1, head);
+			}
+			else {
+				AddNfaChain(edges, stateCount, outside, rule.right, rule.rightLength, head);
+			}
+		}
+	}
+
+	nfa = Nfa();
+	nfa.stateCount = stateCount;
+	nfa.start = leftLinear ? outside : SymbolIndex(gram.startingPoint);
+	nfa.accepting.assign(stateCount, 0);
+	nfa.accepting[leftLinear ? SymbolIndex(gram.startingPoint) : outside] = 1;
+
+	nfa.edgeStarts.assign(stateCount + 1, 0);
+	for (std::vector<NfaEdge>::const_iterator it = edges.begin(); it != edges.end(); it++) {
+		nfa.edgeStarts[it->from + 1]++;
+	}
+	for (size_t i = 1; i < nfa.edgeStarts.size(); i++) {
+		nfa.edgeStarts[i] += nfa.edgeStarts[i - 1];
+	}
+	nfa.edgeColumns.resize(edges.size());
+	nfa.edgeTargets.resize(edges.size());
+	std::vector<uint32_t> fill(nfa.edgeStarts.begin(), nfa.edgeStarts.end() - 1);
+	for (std::vector<NfaEdge>::const_iterator it = edges.begin(); it != edges.end(); it++) {
+		const uint32_t edge = fill[it->from]++;
+		nfa.edgeColumns[edge] = it->column;
+		nfa.edgeTargets[edge] = it->to;
+	}
+
+	return true;
+}
+
+void CloseOverEpsilon(const Nfa& nfa, std::vector<uint32_t>& states, std::vector<uint32_t>& marks, uint32_t& stamp) {
+	// adds every state reachable through epsilon edges, and leaves the states sorted and without duplicates,
+	// marks[s] == stamp meaning s is already in, so the marks never have to be cleared
+	stamp++;
+	size_t kept = 0;
+	for (size_t i = 0; i < states.size(); i++) {
+		if (marks[states[i]] != stamp) {
+			marks[states[i]] = stamp;
+			states[kept++] = states[i];
+		}
+	}
+	states.resize(kept);
+
+	for (size_t i = 0; i < states.size(); i++) {
+		for (uint32_t edge = nfa.edgeStarts[states[i]]; edge < nfa.edgeStarts[states[i] + 1]; edge++) {
+			if (nfa.edgeColumns[edge] == EpsilonColumn && marks[nfa.edgeTargets[edge]] != stamp) {
+				marks[nfa.edgeTargets[edge]] = stamp;
+				states.push_back(nfa.edgeTargets[edge]);
+			}
+		}
+	}
+
+	std::sort(states.begin(), states.end());
+}
+
+struct SequenceSet { // sequences of 32-bit values stored one after another, kept unique through an open addressing table
+	std::vector<uint32_t> values,
+						  offsets = { 0 }, // sequence i is values[offsets[i] .. offsets[i + 1])
+						  slots; // ~0u marks a free slot
+};
+
+inline size_t SequenceCount(const SequenceSet& sequences) {
+	return sequences.offsets.size() - 1;
+}
+
+inline size_t SequenceSlot(const uint32_t* values, size_t count, size_t mask) {
+	uint64_t hash = 0xCBF29CE484222325ull ^ count;
+	for (size_t i = 0; i < count; i++) {
+		hash = (hash ^ values[i]) * 0x9E3779B97F4A7C15ull;
+	}
+	return (size_t)(hash ^ (hash >> 29)) & mask;
+}
+
+uint32_t FindOrAddSequence(SequenceSet& sequences, const std::vector<uint32_t>& values) {
+	// the index of the sequence, which is SequenceCount from before the call if it wasn't there yet
+	const size_t count = SequenceCount(sequences);
+	if (2 * (count + 1) > sequences.slots.size()) { // keeps the table at most half full
+		sequences.slots.assign(std::max<size_t>(16, 2 * sequences.slots.size()), ~0u);
+		const size_t mask = sequences.slots.size() - 1;
+		for (size_t i = 0; i < count; i++) {
+			size_t slot = SequenceSlot(&sequences.values[sequences.offsets[i]], sequences.offsets[i + 1] - sequences.offsets[i], mask);
+			while (sequences.slots[slot] != ~0u) {
+				slot = (slot + 1) & mask;
+			}
+			sequences.slots[slot] = (uint32_t)i;
+		}
+	}
+
+	const size_t mask = sequences.slots.size() - 1;
+	size_t slot = SequenceSlot(values.data(), values.size(), mask);
+	for (; sequences.slots[slot] != ~0u; slot = (slot + 1) & mask) {
+		const uint32_t found = sequences.slots[slot];
+		if (sequences.offsets[found + 1] - sequences.offsets[found] == values.size()
+			&& std::equal(values.begin(), values.end(), sequences.values.begin() + sequences.offsets[found])) {
+			return found;
+		}
+	}
+
+	sequences.slots[slot] = (uint32_t)count;
+	sequences.values.insert(sequences.values.end(), values.begin(), values.end());
+	sequences.offsets.push_back((uint32_t)sequences.values.size());
+	return (uint32_t)count;
+}
+
+bool BuildDfa(const Grammar& gram, Dfa& dfa, std::string& error, size_t maxStates = MaxDfaStates) {
+	Nfa nfa;
+	if (!BuildNfa(gram, nfa, error)) {
+		return false;
+	}
+
+	dfa = Dfa();
+	const uint32_t terminalCount = (uint32_t)gram.terminals.size();
+	dfa.columnCount = terminalCount + 2;
+
+	// subset construction, the DFA states are numbered in the order their sets of NFA states are found, and the empty set comes first as DeadState
+	SequenceSet sets;
+	std::vector<uint32_t> states, marks(nfa.stateCount, 0);
+	uint32_t stamp = 0;
+	FindOrAddSequence(sets, states);
+	states.assign(1, nfa.start);
+	CloseOverEpsilon(nfa, states, marks, stamp);
+	dfa.start = FindOrAddSequence(sets, states);
+
+	std::vector<std::vector<uint32_t>> targets(terminalCount); // where the current set goes for every terminal, before the epsilon edges
+	std::vector<uint32_t> touched;
+	for (uint32_t current = 0; current < SequenceCount(sets); current++) {
+		bool accepting = false;
+		for (uint32_t i = sets.offsets[current]; i < sets.offsets[current + 1]; i++) {
+			const uint32_t state = sets.values[i];
+			accepting = accepting || nfa.accepting[state];
+			for (uint32_t edge = nfa.edgeStarts[state]; edge < nfa.edgeStarts[state + 1]; edge++) {
+				const uint32_t column = nfa.edgeColumns[edge];
+				if (column != EpsilonColumn) {
+					if (targets[column].empty()) {
+						touched.push_back(column);
+					}
+					targets[column].push_back(nfa.edgeTargets[edge]);
+				}
+			}
+		}
+
+		dfa.accepting.push_back(accepting ? 1 : 0);
+		dfa.transitions.resize(dfa.transitions.size() + dfa.columnCount, DeadState);
+		dfa.transitions[(size_t)current * dfa.columnCount + SkipColumn(dfa)] = current;
+		for (std::vector<uint32_t>::const_iterator it = touched.begin(); it != touched.end(); it++) {
+			states.assign(targets[*it].begin(), targets[*it].end());
+			targets[*it].clear();
+			CloseOverEpsilon(nfa, states, marks, stamp);
+			dfa.transitions[(size_t)current * dfa.columnCount + *it] = FindOrAddSequence(sets, states);
+		}
+		touched.clear();
+
+		if (SequenceCount(sets) > maxStates) {
+			error = "the automaton has more than " + std::to_string(maxStates) + " states";
+			return false;
+		}
+	}
+	dfa.stateCount = (uint32_t)dfa.accepting.size();
+
+	bool singleCharacters = true;
+	for (ArenaVector<std::string_view>::const_iterator it = gram.terminals.begin(); it != gram.terminals.end(); it++) {
+		singleCharacters = singleCharacters && it->size() == 1;
+	}
+	if (singleCharacters) {
+		dfa.characterColumns.assign(256, OtherColumn(dfa));
+		dfa.characterColumns[(unsigned char)' '] = dfa.characterColumns[(unsigned char)'\t'] = dfa.characterColumns[(unsigned char)'|'] = SkipColumn(dfa);
+		for (uint32_t i = 0; i < terminalCount; i++) {
+			dfa.characterColumns[(unsigned char)gram.terminals[i][0]] = i;
+		}
+	}
+
+	return true;
+}
+
+bool MatchDfa(const Dfa& dfa, const Symbol* word, size_t length) {
+	// the word has to be made of terminals of the grammar the automaton was built from, as SplitWord makes it
+	uint32_t state = dfa.start;
+	for (size_t i = 0; i < length && state != DeadState; i++) {
+		state = dfa.transitions[(size_t)state * dfa.columnCount + SymbolIndex(word[i])];
+	}
+	return dfa.accepting[state] != 0;
+}
+
+bool MatchDfa(const Dfa& dfa, std::string_view text) {
+	// only when every terminal is a single character (see Dfa::characterColumns), one table lookup per byte
+	const uint32_t* transitions = dfa.transitions.data();
+	const uint32_t* columns = dfa.characterColumns.data();
+	uint32_t state = dfa.start;
+	for (size_t i = 0; i < text.size() && state != DeadState; i++) {
+		state = transitions[(size_t)state * dfa.columnCount + columns[(unsigned char)text[i]]];
+	}
+	return dfa.accepting[state] != 0;
+}
+
+void MinimizeDfa(const Dfa& dfa, Dfa& minimal) {
+	// Hopcroft's partition refinement over the terminal columns, the blocks start out as the accepting and the other states,
+	// and a block is split whenever only some of its states go into the splitter block through a column
+	const uint32_t stateCount = dfa.stateCount,
+				   terminalCount = dfa.columnCount - 2;
+
+	// the states that go to state t through column c are predecessors[predecessorStarts[c * stateCount + t] .. predecessorStarts[c * stateCount + t + 1])
+	std::vector<uint32_t> predecessorStarts((size_t)terminalCount * stateCount + 1, 0), predecessors((size_t)terminalCount * stateCount);
+	for (uint32_t state = 0; state < stateCount; state++) {
+		for (uint32_t column = 0; column < terminalCount; column++) {
+			predecessorStarts[(size_t)column * stateCount + dfa.transitions[(size_t)state * dfa.columnCount + column] + 1]++;
+		}
+	}
+	for (size_t i = 1; i < predecessorStarts.size(); i++) {
+		predecessorStarts[i] += predecessorStarts[i - 1];
+	}
+	std::vector<uint32_t> fill(predecessorStarts.begin(), predecessorStarts.end() - 1);
+	for (uint32_t state = 0; state < stateCount; state++) {
+		for (uint32_t column = 0; column < terminalCount; column++) {
+			predecessors[fill[(size_t)column * stateCount + dfa.transitions[(size_t)state * dfa.columnCount + column]]++] = state;
+		}
+	}
+
+	// the states of block b are elements[blockStarts[b] .. blockEnds[b]), the first marked[b] of them being marked by the current splitter
+	std::vector<uint32_t> elements(stateCount), positions(stateCount), blockOf(stateCount), blockStarts, blockEnds, marked;
+	uint32_t acceptingCount = 0;
+	for (uint32_t state = 0; state < stateCount; state++) {
+		acceptingCount += dfa.accepting[state];
+	}
+	uint32_t nextAccepting = 0, nextOther = acceptingCount;
+	for (uint32_t state = 0; state < stateCount; state++) {
+		positions[state] = dfa.accepting[state] ? nextAccepting++ : nextOther++;
+		elements[positions[state]] = state;
+	}
+	if (acceptingCount > 0) {
+		blockStarts.push_back(0);
+		blockEnds.push_back(acceptingCount);
+	}
+	if (acceptingCount < stateCount) {
+		blockStarts.push_back(acceptingCount);
+		blockEnds.push_back(stateCount);
+	}
+	marked.assign(blockStarts.size(), 0);
+	for (uint32_t state = 0; state < stateCount; state++) {
+		blockOf[state] = (acceptingCount > 0 && !dfa.accepting[state]) ? 1 : 0;
+	}
+
+	std::vector<std::pair<uint32_t, uint32_t>> worklist; // (block, column) splitters still to be used
+	if (blockStarts.size() == 2) { // one of the two is enough, so we take the smaller
+		const uint32_t smaller = (acceptingCount <= stateCount - acceptingCount) ? 0 : 1;
+		for (uint32_t column = 0; column < terminalCount; column++) {
+			worklist.push_back(std::make_pair(smaller, column));
+		}
+	}
+
+	std::vector<uint32_t> splitter, touched;
+	while (!worklist.empty()) {
+		const uint32_t splitterBlock = worklist.back().first, column = worklist.back().second;
+		worklist.pop_back();
+
+		// the splitter can be split itself while we go through it, so we go through a copy
+		splitter.assign(elements.begin() + blockStarts[splitterBlock], elements.begin() + blockEnds[splitterBlock]);
+		for (std::vector<uint32_t>::const_iterator it = splitter.begin(); it != splitter.end(); it++) {
+			const size_t key = (size_t)column * stateCount + *it;
+			for (uint32_t i = predecessorStarts[key]; i < predecessorStarts[key + 1]; i++) {
+				const uint32_t state = predecessors[i], block = blockOf[state];
+				if (positions[state] < blockStarts[block] + marked[block]) { // already marked
+					continue;
+				}
+				if (marked[block] == 0) {
+					touched.push_back(block);
+				}
+
+				// swap the state to the end of the marked states at the front of its block
+				const uint32_t position = blockStarts[block] + marked[block]++, other = elements[position];
+				elements[positions[state]] = other;
+				positions[other] = positions[state];
+				elements[position] = state;
+				positions[state] = position;
+			}
+		}
+
+		for (std::vector<uint32_t>::const_iterator it = touched.begin(); it != touched.end(); it++) {
+			const uint32_t block = *it, markedCount = marked[block], size = blockEnds[block] - blockStarts[block];
+			marked[block] = 0;
+			if (markedCount == size) { // every state of the block goes into the splitter, nothing to split
+				continue;
+			}
+
+			// the smaller part becomes the new block, so every state is moved to a new block O(log n) times
+			const uint32_t newBlock = (uint32_t)blockStarts.size();
+			if (markedCount <= size - markedCount) {
+				blockStarts.push_back(blockStarts[block]);
+				blockEnds.push_back(blockStarts[block] + markedCount);
+				blockStarts[block] += markedCount;
+			}
+			else {
+				blockStarts.push_back(blockStarts[block] + markedCount);
+				blockEnds.push_back(blockEnds[block]);
+				blockEnds[block] = blockStarts[block] + markedCount;
+			}
+			marked.push_back(0);
+			for (uint32_t i = blockStarts[newBlock]; i < blockEnds[newBlock]; i++) {
+				blockOf[elements[i]] = newBlock;
+			}
+
+			// if the old block still has to split others, the new one has to as well, and if it doesn't, the smaller part is enough
+			for (uint32_t splitColumn = 0; splitColumn < terminalCount; splitColumn++) {
+				worklist.push_back(std::make_pair(newBlock, splitColumn));
+			}
+		}
+		touched.clear();
+	}
+
+	// the blocks are numbered again in breadth-first order from the start, going through the columns in order,
+	// so two automatons of the same language over the same terminals come out the same, DeadState's block staying DeadState
+	const uint32_t blockCount = (uint32_t)blockStarts.size();
+	std::vector<uint32_t> order(blockCount, ~0u), queue;
+	order[blockOf[DeadState]] = DeadState;
+	queue.push_back(blockOf[DeadState]);
+	if (order[blockOf[dfa.start]] == ~0u) {
+		order[blockOf[dfa.start]] = (uint32_t)queue.size();
+		queue.push_back(blockOf[dfa.start]);
+	}
+	for (size_t i = 1; i < queue.size(); i++) {
+		const uint32_t representative = elements[blockStarts[queue[i]]];
+		for (uint32_t column = 0; column < terminalCount; column++) {
+			const uint32_t block = blockOf[dfa.transitions[(size_t)representative * dfa.columnCount + column]];
+			if (order[block] == ~0u) {
+				order[block] = (uint32_t)queue.size();
+				queue.push_back(block);
+			}
+		}
+	}
+
+	minimal = Dfa();
+	minimal.stateCount = (uint32_t)queue.size();
+	minimal.columnCount = dfa.columnCount;
+	minimal.start = order[blockOf[dfa.start]];
+	minimal.characterColumns = dfa.characterColumns;
+	minimal.accepting.resize(minimal.stateCount);
+	minimal.transitions.resize((size_t)minimal.stateCount * minimal.columnCount);
+	for (uint32_t state = 0; state < minimal.stateCount; state++) {
+		const uint32_t representative = elements[blockStarts[queue[state]]];
+		minimal.accepting[state] = dfa.accepting[representative];
+		for (uint32_t column = 0; column < terminalCount; column++) {
+			minimal.transitions[(size_t)state * minimal.columnCount + column] = order[blockOf[dfa.transitions[(size_t)representative * dfa.columnCount + column]]];
+		}
+		minimal.transitions[(size_t)state * minimal.columnCount + SkipColumn(minimal)] = state;
+		minimal.transitions[(size_t)state * minimal.columnCount + OtherColumn(minimal)] = DeadState;
+	}
+}
+
+bool HasLiveTransition(const Dfa& dfa, uint32_t state) {
+	for (uint32_t column = 0; column + 2 < dfa.columnCount; column++) {
+		if (dfa.transitions[(size_t)state * dfa.columnCount + column] != DeadState) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void AddStateRules(Grammar& newGram, const Dfa& dfa, const SymbolMap& map, const std::vector<Symbol>& stateSymbols, Symbol left, uint32_t state) {
+	// N -> a for every column a that accepts, and N -> a M for every column a that goes on to the state of M
+	for (uint32_t column = 0; column + 2 < dfa.columnCount; column++) {
+		const uint32_t target = dfa.transitions[(size_t)state * dfa.columnCount + column];
+		if (target == DeadState) {
+			continue;
+		}
+		if (dfa.accepting[target]) {
+			AddProductionRule(newGram, { left }, { map.terminals[column] });
+		}
+		if (stateSymbols[target] != NoSymbol) {
+			AddProductionRule(newGram, { left }, { map.terminals[column], stateSymbols[target] });
+		}
+	}
+}
+
+Grammar CreateGrammarFromDfa(const Grammar& gram, const Dfa& dfa) {
+	// a right-linear grammar with a non-terminal for every state that some word goes on from,
+	// gram being the grammar the automaton was built from, for the names of the terminals
+	Grammar newGram;
+	SymbolMap map;
+	FreshNames names;
+	AddTerminals(newGram, gram, map);
+	newGram.startingPoint = AddFreshNonTerminal(newGram, names, "S");
+	if (dfa.start == DeadState) { // the empty language
+		return newGram;
+	}
+
+	// the starting point can only derive the empty word if it isn't on the right side of any rule,
+	// so a starting state that accepts and is come back to gets a non-terminal of its own
+	std::vector<Symbol> stateSymbols(dfa.stateCount, NoSymbol);
+	bool startReentered = false;
+	for (uint32_t state = 1; state < dfa.stateCount && !startReentered; state++) {
+		for (uint32_t column = 0; column + 2 < dfa.columnCount; column++) {
+			startReentered = startReentered || dfa.transitions[(size_t)state * dfa.columnCount + column] == dfa.start;
+		}
+	}
+	const bool separateStart = dfa.accepting[dfa.start] && startReentered && HasLiveTransition(dfa, dfa.start);
+	if (!separateStart) {
+		stateSymbols[dfa.start] = newGram.startingPoint;
+	}
+
+	uint32_t number = 0;
+	for (uint32_t state = 1; state < dfa.stateCount; state++) {
+		if (stateSymbols[state] == NoSymbol && HasLiveTransition(dfa, state)) {
+			stateSymbols[state] = AddFreshNonTerminal(newGram, names, "Q" + std::to_string(++number));
+		}
+	}
+
+	if (dfa.accepting[dfa.start]) {
+		AddProductionRule(newGram, { newGram.startingPoint }, {});
+	}
+	if (separateStart) {
+		AddStateRules(newGram, dfa, map, stateSymbols, newGram.startingPoint, dfa.start);
+	}
+	for (uint32_t state = 1; state < dfa.stateCount; state++) {
+		if (stateSymbols[state] != NoSymbol) {
+			AddStateRules(newGram, dfa, map, stateSymbols, stateSymbols[state], state);
+		}
+	}
+
+	return newGram;
+}
+
+bool MinimizeGrammar(const Grammar& gram, Grammar& minimalGram, std::string& error) {
+	// the smallest right-linear grammar of the same language, the same for any two grammars of that language with the same terminals
+	Dfa dfa, minimal;
+	if (!BuildDfa(gram, dfa, error)) {
+		return false;
+	}
+
+	MinimizeDfa(dfa, minimal);
+	minimalGram = CreateGrammarFromDfa(gram, minimal);
+	return true;
+}
+
+const uint32_t UnknownState = 0xFFFFFFFFu;
+
+struct LazyDfa { // the subset construction of BuildDfa, done only for the states and transitions somebody asks for
+	Nfa nfa;
+	uint32_t start = DeadState;
+	std::vector<uint32_t> letterColumns, // the terminal of the grammar for every letter, EpsilonColumn if the grammar has none of that name
+						  transitions; // letterColumns.size() for every state, UnknownState until the transition is asked for
+	std::vector<uint8_t> accepting;
+	SequenceSet sets; // the NFA states of every state, the empty set being DeadState
+	std::vector<uint32_t> states, marks; // scratch for CloseOverEpsilon
+	uint32_t stamp = 0;
+};
+
+inline uint32_t LazyStateCount(const LazyDfa& dfa) {
+	return (uint32_t)dfa.accepting.size();
+}
+
+void FindLetters(const Grammar& first, const Grammar& second, std::vector<std::string_view>& letters,
+				 std::vector<uint32_t>& firstColumns, std::vector<uint32_t>& secondColumns) {
+	// the terminals of both grammars matched by name, the ones of the first grammar in order and then the rest of the second,
+	// with the column every letter has in each grammar, EpsilonColumn where that grammar doesn't have it
+	letters.assign(first.terminals.begin(), first.terminals.end());
+	firstColumns.resize(letters.size());
+	secondColumns.assign(letters.size(), EpsilonColumn);
+	for (uint32_t i = 0; i < (uint32_t)letters.size(); i++) {
+		firstColumns[i] = i;
+	}
+
+	for (uint32_t i = 0; i < (uint32_t)second.terminals.size(); i++) {
+		const Symbol symbol = FindSymbol(first, second.terminals[i]);
+		if (symbol != NoSymbol && IsTerminal(symbol)) {
+			secondColumns[SymbolIndex(symbol)] = i;
+			continue;
+		}
+		letters.push_back(second.terminals[i]);
+		firstColumns.push_back(EpsilonColumn);
+		secondColumns.push_back(i);
+	}
+}
+
+uint32_t AddLazyState(LazyDfa& dfa) {
+	// the state of the NFA states in dfa.states, closed over epsilon already, with an empty row if it is new
+	const uint32_t state = FindOrAddSequence(dfa.sets, dfa.states);
+	if (state == LazyStateCount(dfa)) {
+		bool accepting = false;
+		for (std::vector<uint32_t>::const_iterator it = dfa.states.begin(); it != dfa.states.end(); it++) {
+			accepting = accepting || dfa.nfa.accepting[*it];
+		}
+		dfa.accepting.push_back(accepting ? 1 : 0);
+		dfa.transitions.resize(dfa.transitions.size() + dfa.letterColumns.size(), (state == DeadState) ? DeadState : UnknownState);
+	}
+
+	return state;
+}
+
+bool BuildLazyDfa(const Grammar& gram, const std::vector<uint32_t>& letterColumns, LazyDfa& dfa, std::string& error) {
+	// only DeadState and the start are there at first, LazyTransition adds the rest
+	dfa = LazyDfa();
+	if (!BuildNfa(gram, dfa.nfa, error)) {
+		return false;
+	}
+
+	dfa.letterColumns = letterColumns;
+	dfa.marks.assign(dfa.nfa.stateCount, 0);
+	AddLazyState(dfa);
+	dfa.states.assign(1, dfa.nfa.start);
+	CloseOverEpsilon(dfa.nfa, dfa.states, dfa.marks, dfa.stamp);
+	dfa.start = AddLazyState(dfa);
+	return true;
+}
+
+uint32_t LazyTransition(LazyDfa& dfa, uint32_t state, uint32_t letter) {
+	const size_t key = (size_t)state * dfa.letterColumns.size() + letter;
+	if (dfa.transitions[key] != UnknownState) {
+		return dfa.transitions[key];
+	}
+
+	const uint32_t column = dfa.letterColumns[letter];
+	dfa.states.clear();
+	for (uint32_t i = dfa.sets.offsets[state]; i < dfa.sets.offsets[state + 1] && column != EpsilonColumn; i++) {
+		const uint32_t nfaState = dfa.sets.values[i];
+		for (uint32_t edge = dfa.nfa.edgeStarts[nfaState]; edge < dfa.nfa.edgeStarts[nfaState + 1]; edge++) {
+			if (dfa.nfa.edgeColumns[edge] == column) {
+				dfa.states.push_back(dfa.nfa.edgeTargets[edge]);
+			}
+		}
+	}
+	CloseOverEpsilon(dfa.nfa, dfa.states, dfa.marks, dfa.stamp);
+
+	const uint32_t target = AddLazyState(dfa); // can move the rows, so key is used again only after it
+	dfa.transitions[key] = target;
+	return target;
+}
+
+struct EquivalenceResult {
+	bool equivalent = true,
+		 inFirst = false; // whether the counterexample is a word of the first language and not of the second, or the other way around
+	std::vector<std::string_view> counterexample; // the terminals of a word that is in only one of the languages
+	uint32_t firstStates = 0, // how many states of every automaton had to be built
+			 secondStates = 0;
+};
+
+const uint32_t NoPair = 0xFFFFFFFFu;
+
+struct EquivalencePair { // two states the same word goes to, and how it got there
+	uint32_t first,
+			 second,
+			 parent, // the pair the word came from, NoPair for the pair of the starting states
+			 letter;
+};
+
+inline uint32_t FindStateClass(std::vector<uint32_t>& parents, uint32_t element) {
+	// the states of both automatons are elements of one union-find, state s of the first being 2 * s and of the second 2 * s + 1,
+	// and elements past the end of parents haven't been joined with anything yet
+	if (element >= parents.size()) {
+		return element;
+	}
+	while (parents[element] != element) {
+		parents[element] = parents[parents[element]]; // path halving
+		element = parents[element];
+	}
+
+	return element;
+}
+
+bool CheckEquivalence(const Grammar& first, const Grammar& second, EquivalenceResult& result, std::string& error) {
+	// Hopcroft and Karp's check, the starting states are joined, and whenever two joined states go to states of different classes
+	// through a letter, those classes are joined as well. The languages are the same if no class ever holds an accepting
+	// and a rejecting state, and every pair is reached by one word, so the first pair that does is a counterexample.
+	// The automatons are only built as far as the pairs go, and there can be no more joins than states
+	std::vector<std::string_view> letters;
+	std::vector<uint32_t> firstColumns, secondColumns;
+	FindLetters(first, second, letters, firstColumns, secondColumns);
+
+	LazyDfa firstDfa, secondDfa;
+	if (!BuildLazyDfa(first, firstColumns, firstDfa, error) || !BuildLazyDfa(second, secondColumns, secondDfa, error)) {
+		return false;
+	}
+
+	result = EquivalenceResult();
+	std::vector<uint32_t> parents;
+	auto join = [&](uint32_t firstState, uint32_t secondState) {
+		// false if they were in one class already
+		const uint32_t a = FindStateClass(parents, 2 * firstState), b = FindStateClass(parents, 2 * secondState + 1);
+		if (a == b) {
+			return false;
+		}
+		const size_t size = (size_t)std::max(a, b) + 1;
+		for (size_t i = parents.size(); i < size; i++) {
+			parents.push_back((uint32_t)i);
+		}
+		parents[a] = b;
+		return true;
+	};
+
+	std::vector<EquivalencePair> pairs(1, EquivalencePair{ firstDfa.start, secondDfa.start, NoPair, 0 });
+	join(firstDfa.start, secondDfa.start);
+	uint32_t found = (firstDfa.accepting[firstDfa.start] != secondDfa.accepting[secondDfa.start]) ? 0 : NoPair;
+	for (uint32_t current = 0; current < (uint32_t)pairs.size() && found == NoPair; current++) {
+		const EquivalencePair pair = pairs[current];
+		for (uint32_t letter = 0; letter < (uint32_t)letters.size() && found == NoPair; letter++) {
+			const uint32_t firstTarget = LazyTransition(firstDfa, pair.first, letter),
+						   secondTarget = LazyTransition(secondDfa, pair.second, letter);
+			if (join(firstTarget, secondTarget)) {
+				if (firstDfa.accepting[firstTarget] != secondDfa.accepting[secondTarget]) {
+					found = (uint32_t)pairs.size();
+				}
+				pairs.push_back(EquivalencePair{ firstTarget, secondTarget, current, letter });
+			}
+		}
+
+		if (LazyStateCount(firstDfa) > MaxDfaStates || LazyStateCount(secondDfa) > MaxDfaStates) {
+			error = "an automaton has more than " + std::to_string(MaxDfaStates) + " states";
+			return false;
+		}
+	}
+
+	result.firstStates = LazyStateCount(firstDfa);
+	result.secondStates = LazyStateCount(secondDfa);
+	if (found == NoPair) {
+		return true;
+	}
+
+	result.equivalent = false;
+	result.inFirst = firstDfa.accepting[pairs[found].first] != 0;
+	for (uint32_t i = found; pairs[i].parent != NoPair; i = pairs[i].parent) {
+		result.counterexample.push_back(letters[pairs[i].letter]);
+	}
+	std::reverse(result.counterexample.begin(), result.counterexample.end());
+	return true;
+}
+
+int RunMatch(int argc, char* argv[]) {
+	// main --match <grammar file> [word]...: whether every word belongs to the language of a type 3 grammar,
+	// reading one word per line from the standard input when no word is given
+	if (argc < 3) {
+		std::cerr << "usage: " << argv[0] << " --match <grammar file> [word]...\n";
+		return 1;
+	}
+
+	Grammar gram;
+	Dfa dfa;
+	std::string error;
+	if (!LoadGrammarFile(argv[2], gram, error) || !BuildDfa(gram, dfa, error)) {
+		std::cerr << error << '\n';
+		return 1;
+	}
+
+	std::vector<Symbol> word;
+	std::string output;
+	auto matchWord = [&](std::string_view text) {
+		if (!dfa.characterColumns.empty()) {
+			output += MatchDfa(dfa, text) ? "yes\n" : "no\n";
+		}
+		else if (!SplitWord(gram, text, word, error)) {
+			output += error;
+			output += '\n';
+		}
+		else {
+			output += MatchDfa(dfa, word.data(), word.size()) ? "yes\n" : "no\n";
+		}
+	};
+
+	if (argc > 3) {
+		for (int i = 3; i < argc; i++) {
+			output += argv[i];
+			output += ": ";
+			matchWord(argv[i]);
+		}
+		std::cout << output;
+		return 0;
+	}
+
+	std::ios::sync_with_stdio(false); // getline on a synchronized std::cin reads one character at a time
+	std::string line;
+	while (std::getline(std::cin, line)) {
+		if (!line.empty() && line.back() == '\r') {
+			line.pop_back();
+		}
+		matchWord(line);
+		if (output.size() >= LoadChunkSize) {
+			std::cout << output;
+			output.clear();
+		}
+	}
+	std::cout << output;
+
+	return 0;
+}
+
+enum class RegularOperation {
+	Intersection,
+	Difference, // the words of the first language that aren't in the second
+	Complement // the words over the terminals of the first grammar that aren't in its language, the second grammar isn't used
+};
+
+bool BuildProductDfa(const Grammar& first, const Grammar& second, RegularOperation operation, Dfa& dfa, std::string& error) {
+	// the automaton of the operation over the terminals of the first grammar, every state a pair of states of the two lazy automatons,
+	// found breadth-first from the pair of starting states, so only the pairs some word goes to are ever built.
+	// Pairs that can't lead to an accepted word anymore because a side went to its DeadState are all DeadState here
+	STAT_PHASE(StatPhase::ProductAutomaton);
+	const bool complement = operation == RegularOperation::Complement;
+	std::vector<std::string_view> letters;
+	std::vector<uint32_t> firstColumns, secondColumns;
+	FindLetters(first, complement ? first : second, letters, firstColumns, secondColumns);
+
+	LazyDfa firstDfa, secondDfa;
+	if (!BuildLazyDfa(first, firstColumns, firstDfa, error) || (!complement && !BuildLazyDfa(second, secondColumns, secondDfa, error))) {
+		return false;
+	}
+
+	const uint32_t terminalCount = (uint32_t)first.terminals.size(); // the letters of the first grammar are the first ones, and words with others aren't in the result
+	dfa = Dfa();
+	dfa.columnCount = terminalCount + 2;
+
+	SequenceSet pairs;
+	std::vector<uint32_t> pair(2, UnknownState); // DeadState, which no pair of states is
+	FindOrAddSequence(pairs, pair);
+	dfa.accepting.push_back(0);
+	dfa.transitions.resize(dfa.columnCount, DeadState);
+	auto findPair = [&](uint32_t firstState, uint32_t secondState) {
+		if ((!complement && firstState == DeadState) || (operation == RegularOperation::Intersection && secondState == DeadState)) {
+			return DeadState;
+		}
+
+		pair[0] = firstState;
+		pair[1] = secondState;
+		const uint32_t state = FindOrAddSequence(pairs, pair);
+		if (state == dfa.accepting.size()) {
+			bool accepting = firstDfa.accepting[firstState] != 0;
+			if (operation == RegularOperation::Intersection) {
+				accepting = accepting && secondDfa.accepting[secondState];
+			}
+			else if (operation == RegularOperation::Difference) {
+				accepting = accepting && !secondDfa.accepting[secondState];
+			}
+			else {
+				accepting = !accepting;
+			}
+			dfa.accepting.push_back(accepting ? 1 : 0);
+			dfa.transitions.resize(dfa.transitions.size() + dfa.columnCount, DeadState);
+			dfa.transitions[(size_t)state * dfa.columnCount + SkipColumn(dfa)] = state;
+		}
+		return state;
+	};
+
+	dfa.start = findPair(firstDfa.start, complement ? DeadState : secondDfa.start);
+	for (uint32_t current = DeadState + 1; current < SequenceCount(pairs); current++) {
+		const uint32_t firstState = pairs.values[pairs.offsets[current]],
+					   secondState = pairs.values[pairs.offsets[current] + 1];
+		for (uint32_t letter = 0; letter < terminalCount; letter++) {
+			const uint32_t firstTarget = LazyTransition(firstDfa, firstState, letter),
+						   secondTarget = complement ? DeadState : LazyTransition(secondDfa, secondState, letter),
+						   target = findPair(firstTarget, secondTarget);
+			dfa.transitions[(size_t)current * dfa.columnCount + letter] = target;
+		}
+
+		if (SequenceCount(pairs) > MaxDfaStates) {
+			error = "the automaton has more than " + std::to_string(MaxDfaStates) + " states";
+			return false;
+		}
+	}
+	dfa.stateCount = (uint32_t)dfa.accepting.size();
+
+	return true;
+}
+
+bool CreateGrammarFromRegularOperation(const Grammar& gram1, const Grammar& gram2, RegularOperation operation, Grammar& newGram, std::string& error) {
+	// the minimal right-linear grammar of the product automaton, as MinimizeGrammar gives it
+	Dfa product, minimal;
+	if (!BuildProductDfa(gram1, gram2, operation, product, error)) {
+		return false;
+	}
+
+	MinimizeDfa(product, minimal);
+	newGram = CreateGrammarFromDfa(gram1, minimal);
+	return true;
+}
+
+bool CreateGrammarFromIntersection(const Grammar& gram1, const Grammar& gram2, Grammar& newGram, std::string& error) {
+	return CreateGrammarFromRegularOperation(gram1, gram2, RegularOperation::Intersection, newGram, error);
+}
+
+bool CreateGrammarFromDifference(const Grammar& gram1, const Grammar& gram2, Grammar& newGram, std::string& error) {
+	return CreateGrammarFromRegularOperation(gram1, gram2, RegularOperation::Difference, newGram, error);
+}
+
+bool CreateGrammarFromComplement(const Grammar& gram1, Grammar& newGram, std::string& error) {
+	return CreateGrammarFromRegularOperation(gram1, gram1, RegularOperation::Complement, newGram, error);
+}
+
+std::string WordText(const std::vector<std::string_view>& word) {
+	// the terminals one after another, apart if some are longer than a character, and "|" for the empty word, as --enumerate writes them
+	bool spaced = false;
+	for (std::vector<std::string_view>::const_iterator it = word.begin(); it != word.end(); it++) {
+		spaced = spaced || it->size() != 1;
+	}
+
+	std::string text = word.empty() ? "|" : "";
+	for (size_t i = 0; i < word.size(); i++) {
+		if (spaced && i > 0) {
+			text += ' ';
+		}
+		text += word[i];
+	}
+	return text;
+}
+
+int RunEquivalence(int argc, char* argv[]) {
+	// main --equivalent <grammar file> <grammar file>: whether two type 3 grammars have the same language, and a word in only one of them if not,
+	// exiting with 0 only when they do
+	if (argc != 4) {
+		std::cerr << "usage: " << argv[0] << " --equivalent <grammar file> <grammar file>\n";
+		return 1;
+	}
+
+	Grammar first, second;
+	EquivalenceResult result;
+	std::string error;
+	if (!LoadGrammarFile(argv[2], first, error) || !LoadGrammarFile(argv[3], second, error) || !CheckEquivalence(first, second, result, error)) {
+		std::cerr << error << '\n';
+		return 1;
+	}
+
+	if (result.equivalent) {
+		std::cout << "equivalent\n";
+		return 0;
+	}
+
+	std::cout << "not equivalent: " << WordText(result.counterexample) << " is only in the language of " << argv[result.inFirst ? 2 : 3] << '\n';
+	return 1;
+}
+
+int RunRegularOperation(int argc, char* argv[]) {
+	// main --intersect <grammar file> <grammar file> [output file]: a right-linear grammar of the words in both languages
+	// main --difference <grammar file> <grammar file> [output file]: of the words in the first language and not in the second
+	// main --complement <grammar file> [output file]: of the words over its terminals that aren't in the language
+	// of type 3 grammars, written as text, to the standard output if there is no output file
+	const bool complement = strcmp(argv[1], "--complement") == 0;
+	const int inputCount = complement ? 1 : 2;
+	if (argc < 2 + inputCount || argc > 3 + inputCount) {
+		std::cerr << "usage: " << argv[0] << " " << argv[1] << (complement ? " <grammar file>" : " <grammar file> <grammar file>") << " [output file]\n";
+		return 1;
+	}
+
+	Grammar first, second, newGram;
+	std::string error;
+	bool created = LoadGrammarFile(argv[2], first, error) && (complement || LoadGrammarFile(argv[3], second, error));
+	if (created && complement) {
+		created = CreateGrammarFromComplement(first, newGram, error);
+	}
+	else if (created) {
+		created = (strcmp(argv[1], "--intersect") == 0) ? CreateGrammarFromIntersection(first, second, newGram, error)
+														: CreateGrammarFromDifference(first, second, newGram, error);
+	}
+	if (!created) {
+		std::cerr << error << '\n';
+		return 1;
+	}
+
+	if (argc == 2 + inputCount) {
+		SaveGrammar(std::cout, newGram);
+		return 0;
+	}
+
+	std::ofstream output(argv[2 + inputCount], std::ios::binary);
+	SaveGrammar(output, newGram);
+	if (!output) {
+		std::cerr << "could not write \"" << argv[2 + inputCount] << "\"\n";
+		return 1;
+	}
+
+	return 0;
+}
+
+// Simplification functions
+
+/*	The rules being worked on are kept in a SequenceSet, so duplicates go away as they are made,
+	every rule as its left side length followed by the left side and the right side:
+	    [leftLength, left..., right...]
+	Non-terminals are their plain index, as in Symbol, and the index right after the last non-terminal
+	of the grammar is free for a new starting point.
+*/
+
+const uint32_t MaxNullableExpansion = 10; // a rule with more nullable non-terminals than this would turn into more than 1024 rules
+const size_t UnitExpansionFactor = 2, // how many times more rules removing the unit rules may look at, before they are kept instead
+			 UnitExpansionSlack = 4096; // on top of that, so small grammars always lose them
+
+RuleView SequenceRule(const SequenceSet& rules, size_t index) {
+	const uint32_t* values = &rules.values[rules.offsets[index]];
+	RuleView rule;
+	rule.leftLength = values[0];
+	rule.left = values + 1;
+	rule.right = values + 1 + rule.leftLength;
+	rule.rightLength = rules.offsets[index + 1] - rules.offsets[index] - 1 - rule.leftLength;
+	return rule;
+}
+
+void AddSequenceRule(SequenceSet& rules, std::vector<uint32_t>& values, const Symbol* left, uint32_t leftLength, const Symbol* right, uint32_t rightLength) {
+	values.assign(1, leftLength);
+	values.insert(values.end(), left, left + leftLength);
+	values.insert(values.end(), right, right + rightLength);
+	FindOrAddSequence(rules, values);
+}
+
+void GroupRulesByLeftSide(const SequenceSet& rules, uint32_t nonTerminalCount, std::vector<uint32_t>& ruleStarts, std::vector<uint32_t>& grouped) {
+	// the rules of non-terminal n are grouped[ruleStarts[n] .. ruleStarts[n + 1]), for rules with a single non-terminal on the left
+	ruleStarts.assign(nonTerminalCount + 1, 0);
+	grouped.resize(SequenceCount(rules));
+	for (size_t i = 0; i < SequenceCount(rules); i++) {
+		ruleStarts[SequenceRule(rules, i).left[0] + 1]++;
+	}
+	for (size_t i = 1; i < ruleStarts.size(); i++) {
+		ruleStarts[i] += ruleStarts[i - 1];
+	}
+	std::vector<uint32_t> fill(ruleStarts.begin(), ruleStarts.end() - 1);
+	for (size_t i = 0; i < SequenceCount(rules); i++) {
+		grouped[fill[SequenceRule(rules, i).left[0]]++] = (uint32_t)i;
+	}
+}
+
+bool RemoveEmptyWordRules(const Grammar& gram, SequenceSet& rules, Symbol& startingPoint) {
+	// every rule once for every way of leaving out nullable non-terminals from its right side, but never with an empty right side,
+	// after which only the starting point derives the empty word, through a new starting point if it is on some right side.
+	// gives up, without adding anything, if some rule has too many nullable non-terminals to expand
+	const std::vector<uint64_t> nullable = FindNullableNonTerminals(gram);
+	std::vector<uint32_t> positions, values;
+	for (size_t i = 0; i < RuleCount(gram); i++) {
+		RuleView rule = GetRule(gram, i);
+		uint32_t nullableCount = 0;
+		for (uint32_t j = 0; j < rule.rightLength; j++) {
+			nullableCount += (!IsTerminal(rule.right[j]) && HasBit(nullable, rule.right[j])) ? 1 : 0;
+		}
+		if (nullableCount > MaxNullableExpansion) {
+			return false;
+		}
+	}
+
+	std::vector<Symbol> right;
+	bool startOnRightSide = false;
+	for (size_t i = 0; i < RuleCount(gram); i++) {
+		RuleView rule = GetRule(gram, i);
+		positions.clear();
+		for (uint32_t j = 0; j < rule.rightLength; j++) {
+			if (!IsTerminal(rule.right[j]) && HasBit(nullable, rule.right[j])) {
+				positions.push_back(j);
+			}
+			startOnRightSide = startOnRightSide || rule.right[j] == gram.startingPoint;
+		}
+
+		for (uint32_t subset = 0; subset < (1u << positions.size()); subset++) { // bit k of subset leaves out the non-terminal at positions[k]
+			right.clear();
+			size_t next = 0;
+			for (uint32_t j = 0; j < rule.rightLength; j++) {
+				if (next < positions.size() && positions[next] == j) {
+					if ((subset >> next++) & 1) {
+						continue;
+					}
+				}
+				right.push_back(rule.right[j]);
+			}
+
+			if (!right.empty()) {
+				AddSequenceRule(rules, values, rule.left, 1, right.data(), (uint32_t)right.size());
+			}
+		}
+	}
+
+	startingPoint = gram.startingPoint;
+	if (HasBit(nullable, gram.startingPoint)) {
+		if (startOnRightSide) {
+			startingPoint = (Symbol)gram.nonTerminals.size();
+			AddSequenceRule(rules, values, &startingPoint, 1, &gram.startingPoint, 1);
+		}
+		AddSequenceRule(rules, values, &startingPoint, 1, nullptr, 0);
+	}
+
+	return true;
+}
+
+inline bool IsUnitRule(const RuleView& rule) {
+	return rule.leftLength == 1 && rule.rightLength == 1 && !IsTerminal(rule.right[0]);
+}
+
+uint32_t FindComponents(const std::vector<uint32_t>& edgeStarts, const std::vector<uint32_t>& edgeTargets, std::vector<uint32_t>& components) {
+	// the strongly connected components of a graph whose node n has edges to edgeTargets[edgeStarts[n] .. edgeStarts[n + 1]),
+	// found with Tarjan's algorithm, walking the edges with a stack of our own. components[n] is the component of node n,
+	// numbered in the order they are finished, and the number of components is returned
+	const uint32_t nodeCount = (uint32_t)edgeStarts.size() - 1;
+	std::vector<uint32_t> order(nodeCount, ~0u), low(nodeCount), next(edgeStarts.begin(), edgeStarts.end() - 1), stack, frames;
+	std::vector<uint8_t> onStack(nodeCount, 0);
+	components.assign(nodeCount, 0);
+	uint32_t counter = 0, componentCount = 0;
+	for (uint32_t root = 0; root < nodeCount; root++) {
+		if (order[root] != ~0u) {
+			continue;
+		}
+
+		order[root] = low[root] = counter++;
+		stack.push_back(root);
+		onStack[root] = 1;
+		frames.push_back(root);
+		while (!frames.empty()) {
+			const uint32_t node = frames.back();
+			if (next[node] < edgeStarts[node + 1]) {
+				const uint32_t target = edgeTargets[next[node]++];
+				if (order[target] == ~0u) {
+					order[target] = low[target] = counter++;
+					stack.push_back(target);
+					onStack[target] = 1;
+					frames.push_back(target);
+				}
+				else if (onStack[target]) {
+					low[node] = std::min(low[node], order[target]);
+				}
+				continue;
+			}
+
+			frames.pop_back();
+			if (!frames.empty()) {
+				low[frames.back()] = std::min(low[frames.back()], low[node]);
+			}
+			if (low[node] == order[node]) { // the root of a component, which is what's left on the stack down to it
+				uint32_t member = ~0u;
+				while (member != node) {
+					member = stack.back();
+					stack.pop_back();
+					onStack[member] = 0;
+					components[member] = componentCount;
+				}
+				componentCount++;
+			}
+		}
+	}
+
+	return componentCount;
+}
+
+SequenceSet MergeUnitCycles(const SequenceSet& rules, uint32_t nonTerminalCount, Symbol startingPoint) {
+	// non-terminals on a cycle of unit rules (A -> B, B -> A) derive the same words, so each cycle becomes one non-terminal,
+	// the starting point if it is on it. the cycles are the strongly connected components of the unit rules
+	std::vector<uint32_t> unitStarts(nonTerminalCount + 1, 0), unitTargets;
+	for (size_t i = 0; i < SequenceCount(rules); i++) {
+		RuleView rule = SequenceRule(rules, i);
+		if (IsUnitRule(rule)) {
+			unitStarts[rule.left[0] + 1]++;
+		}
+	}
+	for (size_t i = 1; i < unitStarts.size(); i++) {
+		unitStarts[i] += unitStarts[i - 1];
+	}
+	unitTargets.resize(unitStarts.back());
+	std::vector<uint32_t> fill(unitStarts.begin(), unitStarts.end() - 1);
+	for (size_t i = 0; i < SequenceCount(rules); i++) {
+		RuleView rule = SequenceRule(rules, i);
+		if (IsUnitRule(rule)) {
+			unitTargets[fill[rule.left[0]]++] = rule.right[0];
+		}
+	}
+
+	std::vector<uint32_t> components;
+	const uint32_t componentCount = FindComponents(unitStarts, unitTargets, components);
+	if (componentCount == nonTerminalCount) { // no cycles
+		return rules;
+	}
+
+	// every non-terminal of a cycle becomes the smallest one on it, or the starting point
+	std::vector<uint32_t> kept(componentCount, ~0u), merged(nonTerminalCount);
+	for (uint32_t i = 0; i < nonTerminalCount; i++) {
+		kept[components[i]] = std::min(kept[components[i]], i);
+	}
+	if (startingPoint < nonTerminalCount) {
+		kept[components[startingPoint]] = startingPoint;
+	}
+	for (uint32_t i = 0; i < nonTerminalCount; i++) {
+		merged[i] = kept[components[i]];
+	}
+
+	SequenceSet result;
+	std::vector<uint32_t> values;
+	for (size_t i = 0; i < SequenceCount(rules); i++) {
+		RuleView rule = SequenceRule(rules, i);
+		values.assign(1, 1);
+		for (uint32_t j = 0; j < 1 + rule.rightLength; j++) { // the right side comes right after the left one
+			values.push_back(IsTerminal(rule.left[j]) ? rule.left[j] : merged[rule.left[j]]);
+		}
+		if (!(values.size() == 3 && values[1] == values[2])) { // A -> A
+			FindOrAddSequence(result, values);
+		}
+	}
+
+	return result;
+}
+
+SequenceSet RemoveUnitRules(const SequenceSet& rules, uint32_t nonTerminalCount, Symbol startingPoint) {
+	// A -> B goes away, and A gets every other rule of every non-terminal it reaches through such rules instead.
+	// long chains of unit rules would make that quadratic, so if it gets to look at too many rules, the unit rules are kept
+	const SequenceSet acyclic = MergeUnitCycles(rules, nonTerminalCount, startingPoint);
+	const size_t budget = UnitExpansionFactor * SequenceCount(acyclic) + UnitExpansionSlack;
+	std::vector<uint32_t> ruleStarts, grouped, stack, marks(nonTerminalCount, ~0u), values;
+	GroupRulesByLeftSide(acyclic, nonTerminalCount, ruleStarts, grouped);
+
+	SequenceSet result;
+	size_t work = 0;
+	for (uint32_t nonTerminal = 0; nonTerminal < nonTerminalCount; nonTerminal++) {
+		stack.assign(1, nonTerminal);
+		marks[nonTerminal] = nonTerminal;
+		while (!stack.empty()) {
+			const uint32_t reached = stack.back();
+			stack.pop_back();
+			for (uint32_t i = ruleStarts[reached]; i < ruleStarts[reached + 1]; i++) {
+				RuleView rule = SequenceRule(acyclic, grouped[i]);
+				if (IsUnitRule(rule)) {
+					if (marks[rule.right[0]] != nonTerminal) {
+						marks[rule.right[0]] = nonTerminal;
+						stack.push_back(rule.right[0]);
+					}
+				}
+				else {
+					AddSequenceRule(result, values, &nonTerminal, 1, rule.right, rule.rightLength);
+				}
+
+				if (++work > budget) {
+					return acyclic;
+				}
+			}
+		}
+	}
+
+	return result;
+}
+
+SequenceSet RemoveUselessSymbols(const SequenceSet& rules, uint32_t nonTerminalCount, Symbol startingPoint) {
+	// a non-terminal is productive once some rule of it has only terminals and productive non-terminals on the right,
+	// and reachable once it is on the right of a rule of a reachable non-terminal that only has productive ones there,
+	// the rules kept being the ones left of reachable non-terminals with only productive ones on the right
+	const size_t ruleCount = SequenceCount(rules);
+	const size_t words = (nonTerminalCount + 63) / 64;
+	std::vector<uint64_t> productive(words, 0), reachable(words, 0);
+
+	// the rules that use non-terminal n on the right are users[userStarts[n] .. userStarts[n + 1]), once for every time they use it
+	std::vector<uint32_t> remaining(ruleCount, 0), userStarts(nonTerminalCount + 1, 0), users, worklist;
+	for (size_t i = 0; i < ruleCount; i++) {
+		RuleView rule = SequenceRule(rules, i);
+		for (uint32_t j = 0; j < rule.rightLength; j++) {
+			if (!IsTerminal(rule.right[j])) {
+				remaining[i]++;
+				userStarts[rule.right[j] + 1]++;
+			}
+		}
+	}
+	for (size_t i = 1; i < userStarts.size(); i++) {
+		userStarts[i] += userStarts[i - 1];
+	}
+	users.resize(userStarts.back());
+	std::vector<uint32_t> fill(userStarts.begin(), userStarts.end() - 1);
+	for (size_t i = 0; i < ruleCount; i++) {
+		RuleView rule = SequenceRule(rules, i);
+		for (uint32_t j = 0; j < rule.rightLength; j++) {
+			if (!IsTerminal(rule.right[j])) {
+				users[fill[rule.right[j]]++] = (uint32_t)i;
+			}
+		}
+		if (remaining[i] == 0 && !HasBit(productive, rule.left[0])) {
+			SetBit(productive, rule.left[0]);
+			worklist.push_back(rule.left[0]);
+		}
+	}
+
+	while (!worklist.empty()) {
+		const uint32_t nonTerminal = worklist.back();
+		worklist.pop_back();
+		for (uint32_t i = userStarts[nonTerminal]; i < userStarts[nonTerminal + 1]; i++) {
+			const Symbol left = SequenceRule(rules, users[i]).left[0];
+			if (--remaining[users[i]] == 0 && !HasBit(productive, left)) {
+				SetBit(productive, left);
+				worklist.push_back(left);
+			}
+		}
+	}
+
+	SequenceSet result;
+	if (!HasBit(productive, startingPoint)) { // the language is empty
+		return result;
+	}
+
+	std::vector<uint32_t> ruleStarts, grouped, values;
+	GroupRulesByLeftSide(rules, nonTerminalCount, ruleStarts, grouped);
+	SetBit(reachable, startingPoint);
+	worklist.assign(1, startingPoint);
+	while (!worklist.empty()) {
+		const uint32_t nonTerminal = worklist.back();
+		worklist.pop_back();
+		for (uint32_t i = ruleStarts[nonTerminal]; i < ruleStarts[nonTerminal + 1]; i++) {
+			if (remaining[grouped[i]] != 0) { // something on the right is not productive
+				continue;
+			}
+
+			RuleView rule = SequenceRule(rules, grouped[i]);
+			AddSequenceRule(result, values, rule.left, 1, rule.right, rule.rightLength);
+			for (uint32_t j = 0; j < rule.rightLength; j++) {
+				if (!IsTerminal(rule.right[j]) && !HasBit(reachable, rule.right[j])) {
+					SetBit(reachable, rule.right[j]);
+					worklist.push_back(rule.right[j]);
+				}
+			}
+		}
+	}
+
+	return result;
+}
+
+SequenceSet RemoveInapplicableRules(const Grammar& gram) {
+	// for grammars of type 1 and 0: a rule can only ever be applied once every symbol of its left side can show up in a derivation,
+	// which is a fixpoint over a bitset of the symbols (non-terminals first, then the terminals), starting with the starting point.
+	// rules that change nothing go away as well
+	const uint32_t nonTerminalCount = (uint32_t)gram.nonTerminals.size();
+	std::vector<uint64_t> seen((nonTerminalCount + gram.terminals.size() + 63) / 64, 0), applied((RuleCount(gram) + 63) / 64, 0);
+	SetBit(seen, SymbolIndex(gram.startingPoint));
+
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		for (size_t i = 0; i < RuleCount(gram); i++) {
+			if (HasBit(applied, (uint32_t)i)) {
+				continue;
+			}
+
+			RuleView rule = GetRule(gram, i);
+			bool applicable = true;
+			for (uint32_t j = 0; j < rule.leftLength && applicable; j++) {
+				applicable = HasBit(seen, IsTerminal(rule.left[j]) ? nonTerminalCount + SymbolIndex(rule.left[j]) : rule.left[j]);
+			}
+			if (!applicable) {
+				continue;
+			}
+
+			SetBit(applied, (uint32_t)i);
+			for (uint32_t j = 0; j < rule.rightLength; j++) {
+				const uint32_t bit = IsTerminal(rule.right[j]) ? nonTerminalCount + SymbolIndex(rule.right[j]) : rule.right[j];
+				if (!HasBit(seen, bit)) {
+					SetBit(seen, bit);
+					changed = true;
+				}
+			}
+		}
+	}
+
+	SequenceSet result;
+	std::vector<uint32_t> values;
+	for (size_t i = 0; i < RuleCount(gram); i++) {
+		RuleView rule = GetRule(gram, i);
+		if (HasBit(applied, (uint32_t)i) && !(rule.leftLength == rule.rightLength && std::equal(rule.left, rule.left + rule.leftLength, rule.right))) {
+			AddSequenceRule(result, values, rule.left, rule.leftLength, rule.right, rule.rightLength);
+		}
+	}
+
+	return result;
+}
+
+Grammar CreateGrammarFromRules(const Grammar& gram, const SequenceSet& rules, Symbol startingPoint) {
+	// the terminals of gram, and its non-terminals that are still used, along with a new starting point if one was made
+	Grammar newGram;
+	SymbolMap map;
+	FreshNames names;
+	const uint32_t nonTerminalCount = (uint32_t)gram.nonTerminals.size();
+
+	std::vector<uint8_t> used(nonTerminalCount + 1, 0);
+	used[startingPoint] = 1;
+	for (size_t i = 0; i < SequenceCount(rules); i++) {
+		RuleView rule = SequenceRule(rules, i);
+		for (uint32_t j = 0; j < rule.leftLength + rule.rightLength; j++) { // the right side comes right after the left one
+			if (!IsTerminal(rule.left[j])) {
+				used[rule.left[j]] = 1;
+			}
+		}
+	}
+
+	ReserveGrammar(newGram, SymbolCount(gram) + 1, SequenceCount(rules), rules.values.size());
+	AddTerminals(newGram, gram, map);
+	map.nonTerminals.assign(nonTerminalCount + 1, NoSymbol);
+	if (startingPoint == nonTerminalCount) {
+		map.nonTerminals[nonTerminalCount] = AddFreshNonTerminal(newGram, names, SymbolName(gram, gram.startingPoint));
+	}
+	for (uint32_t i = 0; i < nonTerminalCount; i++) {
+		if (used[i]) {
+			map.nonTerminals[i] = AddFreshNonTerminal(newGram, names, gram.nonTerminals[i]);
+		}
+	}
+	newGram.startingPoint = map.nonTerminals[startingPoint];
+
+	std::vector<Symbol> left, right;
+	for (size_t i = 0; i < SequenceCount(rules); i++) {
+		RuleView rule = SequenceRule(rules, i);
+		left.clear();
+		for (uint32_t j = 0; j < rule.leftLength; j++) {
+			left.push_back(MapSymbol(map, rule.left[j]));
+		}
+		right.clear();
+		for (uint32_t j = 0; j < rule.rightLength; j++) {
+			right.push_back(MapSymbol(map, rule.right[j]));
+		}
+		AddProductionRule(newGram, left, right);
+	}
+
+	return newGram;
+}
+
+Grammar SimplifyGrammar(const Grammar& gram) {
+	// a grammar of the same language without useless non-terminals, unit rules or empty word rules (other than for the starting point),
+	// which works after any of the CreateGrammarFrom functions. grammars of type 1 and 0 only lose the rules that can never be applied
+	if (RuleCount(gram) == 0 || gram.startingPoint == NoSymbol) {
+		return gram;
+	}
+
+	const GrammarType type = FindGrammarType(gram);
+	SequenceSet rules;
+	Symbol startingPoint = gram.startingPoint;
+	if (type == GrammarType::Type2 || type == GrammarType::Type3) {
+		const uint32_t nonTerminalCount = (uint32_t)gram.nonTerminals.size() + 1; // room for a new starting point
+		SequenceSet withoutEmpty;
+		if (!RemoveEmptyWordRules(gram, withoutEmpty, startingPoint)) { // keep the empty word rules, the rest still works with them
+			std::vector<uint32_t> values;
+			for (size_t i = 0; i < RuleCount(gram); i++) {
+				RuleView rule = GetRule(gram, i);
+				AddSequenceRule(withoutEmpty, values, rule.left, rule.leftLength, rule.right, rule.rightLength);
+			}
+		}
+		rules = RemoveUselessSymbols(RemoveUnitRules(withoutEmpty, nonTerminalCount, startingPoint), nonTerminalCount, startingPoint);
+	}
+	else {
+		rules = RemoveInapplicableRules(gram);
+	}
+
+	return CreateGrammarFromRules(gram, rules, startingPoint);
+}
+
+int RunRewrite(int argc, char* argv[]) {
+	// main --minimize <grammar file> [output file]: the minimal right-linear grammar of a type 3 grammar
+	// main --simplify <grammar file> [output file]: the grammar without useless symbols, unit rules and empty word rules
+	// both written as text, to the standard output if there is no output file
+	Grammar gram, newGram;
+	std::string error;
+	if (!LoadGrammarFile(argv[2], gram, error)) {
+		std::cerr << error << '\n';
+		return 1;
+	}
+	if (strcmp(argv[1], "--simplify") == 0) {
+		newGram = SimplifyGrammar(gram);
+	}
+	else if (!MinimizeGrammar(gram, newGram, error)) {
+		std::cerr << error << '\n';
+		return 1;
+	}
+
+	if (argc < 4) {
+		SaveGrammar(std::cout, newGram);
+		return 0;
+	}
+
+	std::ofstream output(argv[3], std::ios::binary);
+	SaveGrammar(output, newGram);
+	if (!output) {
+		std::cerr << "could not write \"" << argv[3] << "\"\n";
+		return 1;
+	}
+
+	return 0;
+}
+
+// Analysis functions
+
+struct LanguageProperties { // what AnalyzeLanguage finds out about a context-free grammar, the sets being bitsets over the non-terminals
+	std::vector<uint64_t> productive, // derive some word
+						  reachable, // are in some sentential form of the starting point
+						  nullable; // derive the empty word
+	bool empty = true,
+		 finite = true;
+};
+
+void FindReachable(const Grammar& gram, const std::vector<uint32_t>& ruleStarts, const std::vector<uint32_t>& grouped,
+	const std::vector<uint8_t>* usableRules, std::vector<uint64_t>& reachable) {
+	// every non-terminal in a sentential form of the starting point, only going through the usable rules if there is a list of them
+	reachable.assign((gram.nonTerminals.size() + 63) / 64, 0);
+	if (gram.startingPoint == NoSymbol) {
+		return;
+	}
+
+	std::vector<Symbol> worklist(1, gram.startingPoint);
+	SetBit(reachable, gram.startingPoint);
+	while (!worklist.empty()) {
+		const Symbol nonTerminal = worklist.back();
+		worklist.pop_back();
+		for (uint32_t i = ruleStarts[nonTerminal]; i < ruleStarts[nonTerminal + 1]; i++) {
+			if (usableRules && !(*usableRules)[grouped[i]]) {
+				continue;
+			}
+
+			RuleView rule = GetRule(gram, grouped[i]);
+			for (uint32_t j = 0; j < rule.rightLength; j++) {
+				if (!IsTerminal(rule.right[j]) && !HasBit(reachable, rule.right[j])) {
+					SetBit(reachable, rule.right[j]);
+					worklist.push_back(rule.right[j]);
+				}
+			}
+		}
+	}
+}
+
+bool AnalyzeLanguage(const Grammar& gram, LanguageProperties& properties, std::string& error) {
+	// everything in O(|G|): the productive, nullable and reachable sets are worklist fixpoints, and the language is infinite
+	// exactly when a useful non-terminal A derives u A v with some terminal in u v, which is a cycle of the useful rules going
+	// through a rule that has, next to the non-terminal the cycle goes on with, something that derives a terminal
+	const GrammarType type = FindGrammarType(gram);
+	if (type == GrammarType::Type1 || type == GrammarType::Type0) {
+		error = "whether the language of a type 1 or type 0 grammar is empty can't be decided";
+		return false;
+	}
+
+	const size_t nonTerminalCount = gram.nonTerminals.size(), words = (nonTerminalCount + 63) / 64;
+	properties = LanguageProperties();
+	properties.productive.assign(words, 0);
+	properties.reachable.assign(words, 0);
+	properties.nullable.assign(words, 0);
+	if (gram.startingPoint == NoSymbol) {
+		return true;
+	}
+
+	const RightSideIndex index = BuildRightSideIndex(gram);
+	properties.productive = FindDerivingNonTerminals(gram, index, false);
+	properties.nullable = FindDerivingNonTerminals(gram, index, true);
+
+	std::vector<uint32_t> ruleStarts(nonTerminalCount + 1, 0), grouped(RuleCount(gram));
+	for (size_t i = 0; i < RuleCount(gram); i++) {
+		ruleStarts[GetRule(gram, i).left[0] + 1]++;
+	}
+	for (size_t i = 1; i < ruleStarts.size(); i++) {
+		ruleStarts[i] += ruleStarts[i - 1];
+	}
+	std::vector<uint32_t> fill(ruleStarts.begin(), ruleStarts.end() - 1);
+	for (size_t i = 0; i < RuleCount(gram); i++) {
+		grouped[fill[GetRule(gram, i).left[0]]++] = (uint32_t)i;
+	}
+	FindReachable(gram, ruleStarts, grouped, nullptr, properties.reachable);
+
+	properties.empty = !HasBit(properties.productive, gram.startingPoint);
+	if (properties.empty) {
+		return true;
+	}
+
+	// the useful rules only have productive non-terminals on the right, and the ones that derive a terminal
+	// are found the same way the productive ones are, starting from the useful rules with a terminal on the right
+	std::vector<uint8_t> usefulRules(RuleCount(gram), 1);
+	std::vector<uint64_t> growing(words, 0);
+	std::vector<uint32_t> worklist;
+	for (size_t i = 0; i < RuleCount(gram); i++) {
+		RuleView rule = GetRule(gram, i);
+		bool terminal = false;
+		for (uint32_t j = 0; j < rule.rightLength; j++) {
+			if (IsTerminal(rule.right[j])) {
+				terminal = true;
+			}
+			else if (!HasBit(properties.productive, rule.right[j])) {
+				usefulRules[i] = 0;
+			}
+		}
+
+		if (usefulRules[i] && terminal && !HasBit(growing, rule.left[0])) {
+			SetBit(growing, rule.left[0]);
+			worklist.push_back(rule.left[0]);
+		}
+	}
+	while (!worklist.empty()) {
+		const Symbol nonTerminal = worklist.back();
+		worklist.pop_back();
+
+		size_t count = 0;
+		const uint32_t* occurrences = RightSideOccurrences(index, nonTerminal, count);
+		for (size_t i = 0; i < count; i++) {
+			const Symbol left = GetRule(gram, occurrences[i]).left[0];
+			if (usefulRules[occurrences[i]] && !HasBit(growing, left)) {
+				SetBit(growing, left);
+				worklist.push_back(left);
+			}
+		}
+	}
+
+	// the edges A -> B of the useful rules of useful non-terminals, and whether the rest of the rule derives a terminal
+	std::vector<uint64_t> useful;
+	FindReachable(gram, ruleStarts, grouped, &usefulRules, useful);
+	std::vector<uint32_t> edgeStarts(nonTerminalCount + 1, 0), edgeTargets;
+	std::vector<uint8_t> growingEdges;
+	for (uint32_t nonTerminal = 0; nonTerminal < nonTerminalCount; nonTerminal++) {
+		for (uint32_t i = ruleStarts[nonTerminal]; i < ruleStarts[nonTerminal + 1] && HasBit(useful, nonTerminal); i++) {
+			if (!usefulRules[grouped[i]]) {
+				continue;
+			}
+
+			RuleView rule = GetRule(gram, grouped[i]);
+			uint32_t growingSymbols = 0;
+			for (uint32_t j = 0; j < rule.rightLength; j++) {
+				growingSymbols += (IsTerminal(rule.right[j]) || HasBit(growing, rule.right[j])) ? 1 : 0;
+			}
+			for (uint32_t j = 0; j < rule.rightLength; j++) {
+				if (!IsTerminal(rule.right[j])) {
+					edgeTargets.push_back(rule.right[j]);
+					growingEdges.push_back(growingSymbols > (HasBit(growing, rule.right[j]) ? 1u : 0u));
+				}
+			}
+		}
+		edgeStarts[nonTerminal + 1] = (uint32_t)edgeTargets.size();
+	}
+
+	std::vector<uint32_t> components;
+	FindComponents(edgeStarts, edgeTargets, components);
+	for (uint32_t nonTerminal = 0; nonTerminal < nonTerminalCount && properties.finite; nonTerminal++) {
+		for (uint32_t i = edgeStarts[nonTerminal]; i < edgeStarts[nonTerminal + 1]; i++) {
+			if (growingEdges[i] && components[edgeTargets[i]] == components[nonTerminal]) {
+				properties.finite = false;
+				break;
+			}
+		}
+	}
+
+	return true;
+}
+
+void PrintNonTerminalSet(std::ostream& output, const Grammar& gram, const std::vector<uint64_t>& set, bool inSet) {
+	bool any = false;
+	for (uint32_t i = 0; i < gram.nonTerminals.size(); i++) {
+		if (HasBit(set, i) == inSet) {
+			output << ' ' << gram.nonTerminals[i];
+			any = true;
+		}
+	}
+	if (!any) {
+		output << " -";
+	}
+}
+
+void PrintLanguageProperties(std::ostream& output, const Grammar& gram, const LanguageProperties& properties) {
+	output << "language: " << (properties.empty ? "empty" : (properties.finite ? "finite" : "infinite")) << '\n';
+	output << "productive:";
+	PrintNonTerminalSet(output, gram, properties.productive, true);
+	output << "\nunproductive:";
+	PrintNonTerminalSet(output, gram, properties.productive, false);
+	output << "\nunreachable:";
+	PrintNonTerminalSet(output, gram, properties.reachable, false);
+	output << "\nnullable:";
+	PrintNonTerminalSet(output, gram, properties.nullable, true);
+	output << '\n';
+}
+
+int RunAnalysis(int argc, char* argv[]) {
+	// main --analyze <grammar file>...: whether the language is empty, finite or infinite, and which non-terminals are of any use
+	int result = 0;
+	for (int i = 2; i < argc; i++) {
+		Grammar gram;
+		LanguageProperties properties;
+		std::string error;
+		std::cout << argv[i] << ":\n";
+		if (!LoadGrammarFile(argv[i], gram, error) || !AnalyzeLanguage(gram, properties, error)) {
+			std::cout << error << '\n';
+			result = 1;
+			continue;
+		}
+
+		PrintLanguageProperties(std::cout, gram, properties);
+	}
+
+	return result;
+}
+
+// Expression functions
+
+/*	A language expression is a DAG of operations over grammars that is only turned into a grammar at the end, all at once.
+	Nodes are hash-consed, so building the same subexpression twice gives back the same node, which then becomes
+	a single set of rules that every use of it shares. Since the rules of a shared node can't be rewritten for each place
+	it is used, the operations are the ones of type 2 (or of type 1 and 0 under a closure that needs them),
+	so an expression over type 3 grammars comes out as type 2. Only context-free nodes are shared, though: a rule with
+	more than one symbol on the left could rewrite symbols that another use of the node derived, so a node that isn't
+	context-free is copied for every use, as the eager operations copy their operands. The grammars have to outlive the expression.
+*/
+
+const uint32_t NoExpression = 0xFFFFFFFFu;
+
+enum class ExpressionKind : uint32_t {
+	Grammar,
+	Union,
+	Product,
+	Closure
+};
+
+struct ExpressionNode {
+	ExpressionKind kind;
+	uint32_t left, // the operands, NoExpression if there is none
+			 right;
+	const Grammar* grammar; // only for ExpressionKind::Grammar
+	bool contextFree; // whether everything below has a single non-terminal on the left of every rule
+};
+
+struct LanguageExpression {
+	std::vector<ExpressionNode> nodes; // the operands of a node always come before it
+	SequenceSet keys; // [kind, left, right] of every node, the two halves of the address for grammars, in the same order as nodes
+};
+
+uint32_t AddExpressionNode(LanguageExpression& expression, const ExpressionNode& node, uint32_t first, uint32_t second) {
+	const std::vector<uint32_t> key = { (uint32_t)node.kind, first, second };
+	const uint32_t index = FindOrAddSequence(expression.keys, key);
+	if (index == expression.nodes.size()) {
+		expression.nodes.push_back(node);
+	}
+	return index;
+}
+
+uint32_t AddGrammarExpression(LanguageExpression& expression, const Grammar& gram) {
+	const GrammarType type = FindGrammarType(gram);
+	const uint64_t address = (uint64_t)(uintptr_t)&gram;
+	return AddExpressionNode(expression, ExpressionNode{ ExpressionKind::Grammar, NoExpression, NoExpression, &gram, type != GrammarType::Type0 && type != GrammarType::Type1 },
+		(uint32_t)address, (uint32_t)(address >> 32));
+}
+
+uint32_t AddUnionExpression(LanguageExpression& expression, uint32_t left, uint32_t right) {
+	if (left == right) { // L | L = L
+		return left;
+	}
+	if (left > right) { // the union doesn't care about the order, so both orders are the same node
+		std::swap(left, right);
+	}
+	return AddExpressionNode(expression, ExpressionNode{ ExpressionKind::Union, left, right, nullptr, expression.nodes[left].contextFree && expression.nodes[right].contextFree }, left, right);
+}
+
+uint32_t AddProductExpression(LanguageExpression& expression, uint32_t left, uint32_t right) {
+	return AddExpressionNode(expression, ExpressionNode{ ExpressionKind::Product, left, right, nullptr, expression.nodes[left].contextFree && expression.nodes[right].contextFree }, left, right);
+}
+
+uint32_t AddClosureExpression(LanguageExpression& expression, uint32_t operand) {
+	if (expression.nodes[operand].kind == ExpressionKind::Closure) { // (L*)* = L*
+		return operand;
+	}
+	return AddExpressionNode(expression, ExpressionNode{ ExpressionKind::Closure, operand, NoExpression, nullptr, expression.nodes[operand].contextFree }, operand, NoExpression);
+}
+
+struct ExpressionCopy { // a use of a node that isn't context-free, which gets rules of its own
+	uint32_t node,
+			 left, // the copies of its operands, NoExpression if there is none or the operand is context-free and shared
+			 right;
+};
+
+Symbol AddGrammarCopy(Grammar& newGram, FreshNames& names, const Grammar& gram, SymbolMap& map) {
+	// the non-terminals and the rules of the grammar under new names, its terminals being in map already, and its starting point
+	AddNonTerminals(newGram, names, gram, map);
+	AddMappedRules(newGram, gram, map);
+	return MapStartingPoint(newGram, names, gram, map);
+}
+
+Symbol AddOperationRules(Grammar& newGram, FreshNames& names, const LanguageExpression& expression, const std::vector<SymbolMap>& maps,
+						 uint32_t index, Symbol leftStart, Symbol rightStart) {
+	// a new non-terminal for the operation of the node, with the rules that combine the starting points of its operands
+	const ExpressionNode& node = expression.nodes[index];
+	const Symbol start = AddFreshNonTerminal(newGram, names, "S");
+	switch (node.kind) {
+		case ExpressionKind::Union: {
+			AddProductionRule(newGram, { start }, { leftStart });
+			AddProductionRule(newGram, { start }, { rightStart });
+			break;
+		}
+		case ExpressionKind::Product: {
+			AddProductionRule(newGram, { start }, { leftStart, rightStart });
+			break;
+		}
+		case ExpressionKind::Closure: {
+			if (node.contextFree) {
+				AddProductionRule(newGram, { start }, { start, leftStart });
+				AddProductionRule(newGram, { start }, {});
+				break;
+			}
+
+			// as in AddProductionRulesClosure01, with the terminals of every grammar under the operand
+			const Symbol repeat = AddFreshNonTerminal(newGram, names, "X");
+			AddProductionRule(newGram, { start }, { leftStart });
+			AddProductionRule(newGram, { start }, {});
+			AddProductionRule(newGram, { start }, { repeat, leftStart });
+
+			std::vector<uint8_t> seenTerminals(newGram.terminals.size(), 0), visited(index + 1, 0);
+			std::vector<uint32_t> stack(1, node.left);
+			while (!stack.empty()) {
+				const uint32_t below = stack.back();
+				stack.pop_back();
+				if (visited[below]) {
+					continue;
+				}
+				visited[below] = 1;
+
+				const ExpressionNode& belowNode = expression.nodes[below];
+				if (belowNode.kind != ExpressionKind::Grammar) {
+					stack.push_back(belowNode.left);
+					if (belowNode.right != NoExpression) {
+						stack.push_back(belowNode.right);
+					}
+					continue;
+				}
+
+				for (std::vector<Symbol>::const_iterator itT = maps[below].terminals.begin(); itT != maps[below].terminals.end(); itT++) {
+					if (!seenTerminals[SymbolIndex(*itT)]) {
+						seenTerminals[SymbolIndex(*itT)] = 1;
+						AddProductionRule(newGram, { repeat, *itT }, { leftStart, *itT });
+						AddProductionRule(newGram, { repeat, *itT }, { repeat, leftStart, *itT });
+					}
+				}
+			}
+			break;
+		}
+		default: {
+			break;
+		}
+	}
+
+	return start;
+}
+
+Grammar CreateGrammarFromExpression(const LanguageExpression& expression, uint32_t root) {
+	// the context-free nodes under the root are turned into rules once each, however often they are used,
+	// and the others once for every use, every operation getting a new non-terminal that combines the starting points of its operands
+	std::vector<uint8_t> used(root + 1, 0);
+	used[root] = 1;
+	for (uint32_t i = root + 1; i-- > 0;) { // the operands of a node come before it, so going down the indices sees every node after its users
+		if (used[i] && expression.nodes[i].kind != ExpressionKind::Grammar) {
+			used[expression.nodes[i].left] = 1;
+			if (expression.nodes[i].right != NoExpression) {
+				used[expression.nodes[i].right] = 1;
+			}
+		}
+	}
+
+	// the expression unfolded into a tree from the root down to its context-free nodes, the operands of a copy coming after it
+	std::vector<ExpressionCopy> copies(1, ExpressionCopy{ root, NoExpression, NoExpression });
+	for (size_t i = 0; i < copies.size(); i++) {
+		const ExpressionNode& node = expression.nodes[copies[i].node];
+		if (node.contextFree || node.kind == ExpressionKind::Grammar) {
+			continue;
+		}
+		copies[i].left = (uint32_t)copies.size();
+		copies.push_back(ExpressionCopy{ node.left, NoExpression, NoExpression });
+		if (node.right != NoExpression) {
+			copies[i].right = (uint32_t)copies.size();
+			copies.push_back(ExpressionCopy{ node.right, NoExpression, NoExpression });
+		}
+	}
+
+	Grammar newGram;
+	FreshNames names;
+	std::vector<SymbolMap> maps(root + 1);
+	size_t symbolCount = 1, ruleCount = 0, ruleSymbolCount = 0;
+	for (uint32_t i = 0; i <= root; i++) {
+		if (used[i] && expression.nodes[i].kind == ExpressionKind::Grammar) {
+			symbolCount += SymbolCount(*expression.nodes[i].grammar);
+			ruleCount += RuleCount(*expression.nodes[i].grammar);
+			ruleSymbolCount += RuleSymbolCount(*expression.nodes[i].grammar);
+		}
+		else if (used[i]) {
+			symbolCount += 2;
+			ruleCount += 2;
+			ruleSymbolCount += 3;
+		}
+	}
+	ReserveGrammar(newGram, symbolCount, ruleCount, ruleSymbolCount);
+
+	for (uint32_t i = 0; i <= root; i++) { // all the terminals first, so that no non-terminal takes the name of one
+		if (used[i] && expression.nodes[i].kind == ExpressionKind::Grammar) {
+			AddTerminals(newGram, *expression.nodes[i].grammar, maps[i]);
+		}
+	}
+
+	// the starting point of every shared node, a grammar without one being a non-terminal without rules
+	std::vector<Symbol> starts(root + 1, NoSymbol);
+	for (uint32_t i = 0; i <= root; i++) {
+		const ExpressionNode& node = expression.nodes[i];
+		if (!used[i] || !node.contextFree) {
+			continue;
+		}
+
+		if (node.kind == ExpressionKind::Grammar) {
+			starts[i] = AddGrammarCopy(newGram, names, *node.grammar, maps[i]);
+		}
+		else {
+			starts[i] = AddOperationRules(newGram, names, expression, maps, i, starts[node.left], (node.right != NoExpression) ? starts[node.right] : NoSymbol);
+		}
+	}
+
+	// and of every copy, going up from the leaves of the tree
+	std::vector<Symbol> copyStarts(copies.size(), NoSymbol);
+	for (size_t i = copies.size(); i-- > 0;) {
+		const ExpressionCopy& copy = copies[i];
+		const ExpressionNode& node = expression.nodes[copy.node];
+		if (node.contextFree) {
+			copyStarts[i] = starts[copy.node];
+		}
+		else if (node.kind == ExpressionKind::Grammar) {
+			copyStarts[i] = AddGrammarCopy(newGram, names, *node.grammar, maps[copy.node]);
+		}
+		else {
+			copyStarts[i] = AddOperationRules(newGram, names, expression, maps, copy.node, copyStarts[copy.left], (copy.right != NoExpression) ? copyStarts[copy.right] : NoSymbol);
+		}
+	}
+	newGram.startingPoint = copyStarts[0];
+
+	return newGram;
+}
+
+// Enumeration functions
+
+/*	Words are enumerated by expanding sentential forms, starting with the starting point. Once the grammar is simplified,
+	no rule shrinks a form (besides S -> | for a starting point that is on no right side, which is handled on its own),
+	so a form longer than the longest word we want can be dropped, and no rule lowers its length plus its number of terminals either.
+	The forms are kept in buckets by that measure, and a bucket is done for good once every form in it is expanded,
+	so it is freed and, if it holds words, they are written out, all the words of one length at a time.
+	Context-free grammars only expand the leftmost non-terminal, grammars of type 1 every place some left side fits.
+*/
+
+const size_t EnumerationChunk = 64; // forms per chunk handed to a thread
+const size_t FormShardCount = 64;
+
+struct FormSet { // the sentential forms of one bucket, which any number of threads can add to, every shard having a lock of its own
+	SequenceSet shards[FormShardCount];
+	std::mutex locks[FormShardCount];
+};
+
+struct EnumerationGrammar {
+	Grammar gram; // the simplified grammar, which the words are made of
+	bool contextFree = false,
+		 acceptsEmptyWord = false,
+		 spacedWords = false; // whether the terminals have to be written apart, since some are longer than a character
+	std::vector<uint32_t> ruleStarts, // the rules whose left side starts with a symbol are rules[ruleStarts[key] .. ruleStarts[key + 1]), see SymbolKey
+						  rules;
+};
+
+inline uint32_t SymbolKey(const Grammar& gram, Symbol symbol) { // non-terminals first, then the terminals
+	return IsTerminal(symbol) ? (uint32_t)gram.nonTerminals.size() + SymbolIndex(symbol) : symbol;
+}
+
+inline size_t FormShard(const std::vector<uint32_t>& form) {
+	return (size_t)(((uint64_t)SequenceSlot(form.data(), form.size(), ~(size_t)0) * 0x9E3779B97F4A7C15ull) >> 58) % FormShardCount;
+}
+
+bool AddForm(FormSet& set, const std::vector<uint32_t>& form) {
+	const size_t shard = FormShard(form);
+	std::lock_guard<std::mutex> lock(set.locks[shard]);
+	const size_t count = SequenceCount(set.shards[shard]);
+	return FindOrAddSequence(set.shards[shard], form) == count;
+}
+
+void CopyForm(FormSet& set, size_t shard, size_t index, std::vector<uint32_t>& form) {
+	std::lock_guard<std::mutex> lock(set.locks[shard]); // someone may be adding to the same shard
+	const SequenceSet& forms = set.shards[shard];
+	form.assign(forms.values.begin() + forms.offsets[index], forms.values.begin() + forms.offsets[index + 1]);
+}
+
+inline uint32_t FormMeasure(const std::vector<uint32_t>& form) {
+	uint32_t measure = (uint32_t)form.size();
+	for (std::vector<uint32_t>::const_iterator it = form.begin(); it != form.end(); it++) {
+		measure += IsTerminal(*it) ? 1 : 0;
+	}
+	return measure;
+}
+
+bool PrepareEnumeration(const Grammar& gram, EnumerationGrammar& enumeration, std::string& error) {
+	const GrammarType type = FindGrammarType(gram);
+	if (type == GrammarType::Type0) {
+		error = "the rules of a type 0 grammar can shrink what they derive, so its words can't be enumerated by length";
+		return false;
+	}
+	if (gram.startingPoint == NoSymbol) {
+		error = "the grammar has no starting point";
+		return false;
+	}
+
+	enumeration = EnumerationGrammar();
+	enumeration.gram = SimplifyGrammar(gram);
+	enumeration.contextFree = type != GrammarType::Type1;
+	const Grammar& simple = enumeration.gram;
+
+	bool startOnRightSide = false;
+	for (size_t i = 0; i < RuleCount(simple); i++) {
+		RuleView rule = GetRule(simple, i);
+		startOnRightSide = startOnRightSide || std::find(rule.right, rule.right + rule.rightLength, simple.startingPoint) != rule.right + rule.rightLength;
+		if (rule.rightLength == 0 && rule.leftLength == 1 && rule.left[0] == simple.startingPoint) {
+			enumeration.acceptsEmptyWord = true;
+		}
+		else if (rule.rightLength < rule.leftLength) {
+			error = "some rules still shrink what they derive after simplifying the grammar";
+			return false;
+		}
+	}
+	if (enumeration.acceptsEmptyWord && startOnRightSide) {
+		error = "the starting point derives the empty word and is on a right side";
+		return false;
+	}
+
+	for (ArenaVector<std::string_view>::const_iterator it = simple.terminals.begin(); it != simple.terminals.end(); it++) {
+		enumeration.spacedWords = enumeration.spacedWords || it->size() != 1;
+	}
+
+	const size_t keyCount = simple.nonTerminals.size() + simple.terminals.size();
+	enumeration.ruleStarts.assign(keyCount + 1, 0);
+	for (size_t i = 0; i < RuleCount(simple); i++) {
+		RuleView rule = GetRule(simple, i);
+		if (rule.rightLength > 0) {
+			enumeration.ruleStarts[SymbolKey(simple, rule.left[0]) + 1]++;
+		}
+	}
+	for (size_t i = 1; i < enumeration.ruleStarts.size(); i++) {
+		enumeration.ruleStarts[i] += enumeration.ruleStarts[i - 1];
+	}
+	enumeration.rules.resize(enumeration.ruleStarts.back());
+	std::vector<uint32_t> fill(enumeration.ruleStarts.begin(), enumeration.ruleStarts.end() - 1);
+	for (size_t i = 0; i < RuleCount(simple); i++) {
+		RuleView rule = GetRule(simple, i);
+		if (rule.rightLength > 0) {
+			enumeration.rules[fill[SymbolKey(simple, rule.left[0])]++] = (uint32_t)i;
+		}
+	}
+
+	return true;
+}
+
+void ExpandForm(const EnumerationGrammar& enumeration, const std::vector<uint32_t>& form, uint32_t maxLength, std::vector<FormSet>& buckets, std::vector<uint32_t>& expanded) {
+	const Grammar& gram = enumeration.gram;
+	for (size_t position = 0; position < form.size(); position++) {
+		if (enumeration.contextFree && IsTerminal(form[position])) {
+			continue;
+		}
+
+		const uint32_t key = SymbolKey(gram, form[position]);
+		for (uint32_t i = enumeration.ruleStarts[key]; i < enumeration.ruleStarts[key + 1]; i++) {
+			RuleView rule = GetRule(gram, enumeration.rules[i]);
+			if (form.size() - rule.leftLength + rule.rightLength > maxLength || position + rule.leftLength > form.size()
+				|| !std::equal(rule.left, rule.left + rule.leftLength, form.begin() + position)) {
+				continue;
+			}
+
+			expanded.assign(form.begin(), form.begin() + position);
+			expanded.insert(expanded.end(), rule.right, rule.right + rule.rightLength);
+			expanded.insert(expanded.end(), form.begin() + position + rule.leftLength, form.end());
+			AddForm(buckets[FormMeasure(expanded)], expanded);
+		}
+
+		if (enumeration.contextFree) { // the leftmost non-terminal is enough, every word has a leftmost derivation
+			break;
+		}
+	}
+}
+
+void AppendWord(std::string& output, const EnumerationGrammar& enumeration, const uint32_t* word, size_t length) {
+	if (length == 0) {
+		output += '|';
+	}
+	for (size_t i = 0; i < length; i++) {
+		if (enumeration.spacedWords && i > 0) {
+			output += ' ';
+		}
+		output += SymbolName(enumeration.gram, word[i]);
+	}
+	output += '\n';
+}
+
+size_t EnumerateLanguage(const EnumerationGrammar& enumeration, uint32_t maxLength, unsigned threads, std::ostream& output) {
+	// writes every word of the language up to maxLength once, shorter words first, and returns how many there were
+	std::string buffer;
+	size_t wordCount = 0;
+	if (enumeration.acceptsEmptyWord) {
+		AppendWord(buffer, enumeration, nullptr, 0);
+		wordCount++;
+	}
+
+	const Grammar& gram = enumeration.gram;
+	std::vector<FormSet> buckets(2 * (size_t)maxLength + 1); // a form no longer than maxLength has a measure of at most twice that
+	if (maxLength > 0 && RuleCount(gram) > 0) {
+		AddForm(buckets[1], std::vector<uint32_t>(1, gram.startingPoint));
+	}
+
+	std::vector<std::pair<uint32_t, uint32_t>> work; // (shard, index) of the forms of this round
+	std::vector<std::vector<uint32_t>> words;
+	for (size_t measure = 1; measure < buckets.size(); measure++) {
+		FormSet& bucket = buckets[measure];
+
+		// a round expands the forms the last one added to the bucket itself, until it adds none
+		std::vector<uint32_t> expandedCount(FormShardCount, 0);
+		while (true) {
+			work.clear();
+			for (uint32_t shard = 0; shard < FormShardCount; shard++) {
+				for (uint32_t i = expandedCount[shard]; i < SequenceCount(bucket.shards[shard]); i++) {
+					work.push_back(std::make_pair(shard, i));
+				}
+				expandedCount[shard] = (uint32_t)SequenceCount(bucket.shards[shard]);
+			}
+			if (work.empty()) {
+				break;
+			}
+
+			std::atomic<size_t> nextChunk(0);
+			const size_t chunkCount = (work.size() + EnumerationChunk - 1) / EnumerationChunk;
+			auto expandChunks = [&]() {
+				std::vector<uint32_t> form, expanded;
+				for (size_t chunk = nextChunk++; chunk < chunkCount; chunk = nextChunk++) {
+					const size_t end = std::min(work.size(), (chunk + 1) * EnumerationChunk);
+					for (size_t i = chunk * EnumerationChunk; i < end; i++) {
+						CopyForm(bucket, work[i].first, work[i].second, form);
+						ExpandForm(enumeration, form, maxLength, buckets, expanded);
+					}
+				}
+			};
+
+			if (threads <= 1 || chunkCount == 1) {
+				expandChunks();
+			}
+			else {
+				std::vector<std::thread> workers;
+				for (unsigned i = 0; i < threads && i < chunkCount; i++) {
+					workers.emplace_back(expandChunks);
+				}
+				for (std::vector<std::thread>::iterator it = workers.begin(); it != workers.end(); it++) {
+					it->join();
+				}
+			}
+		}
+
+		// the forms that are all terminals are the words of length measure / 2, sorted so the output doesn't depend on the threads
+		words.clear();
+		for (uint32_t shard = 0; shard < FormShardCount; shard++) {
+			SequenceSet& forms = bucket.shards[shard];
+			for (size_t i = 0; i < SequenceCount(forms); i++) {
+				if (forms.offsets[i + 1] - forms.offsets[i] == measure / 2 && measure % 2 == 0) {
+					words.emplace_back(forms.values.begin() + forms.offsets[i], forms.values.begin() + forms.offsets[i + 1]);
+				}
+			}
+			forms = SequenceSet();
+		}
+
+		std::sort(words.begin(), words.end());
+		for (std::vector<std::vector<uint32_t>>::const_iterator it = words.begin(); it != words.end(); it++) {
+			AppendWord(buffer, enumeration, it->data(), it->size());
+			if (buffer.size() >= LoadChunkSize) {
+				output << buffer;
+				buffer.clear();
+			}
+		}
+		wordCount += words.size();
+	}
+
+	output << buffer;
+	return wordCount;
+}
+
+// Sampling functions
+
+struct SampleTables { // how many derivations there are of every length, from every non-terminal and from every rest of every rule
+	uint32_t maxLength = 0;
+	std::vector<double> counts; // counts[n * (maxLength + 1) + l] for non-terminal n and length l
+	std::vector<uint32_t> restStarts; // the rest of rule r from right[i] on is row restStarts[r] + i of rests
+	std::vector<double> rests;
+	std::vector<uint32_t> ruleStarts, // the rules of non-terminal n are rules[ruleStarts[n] .. ruleStarts[n + 1])
+						  rules;
+};
+
+inline double SymbolDerivations(const SampleTables& tables, Symbol symbol, uint32_t length) {
+	if (IsTerminal(symbol)) {
+		return (length == 1) ? 1.0 : 0.0;
+	}
+	return tables.counts[(size_t)symbol * (tables.maxLength + 1) + length];
+}
+
+inline double RestDerivations(const SampleTables& tables, uint32_t rule, uint32_t offset, uint32_t length) {
+	return tables.rests[((size_t)tables.restStarts[rule] + offset) * (tables.maxLength + 1) + length];
+}
+
+bool BuildSampleTables(const EnumerationGrammar& enumeration, uint32_t maxLength, SampleTables& tables, std::string& error) {
+	const Grammar& gram = enumeration.gram;
+	if (!enumeration.contextFree) {
+		error = "only words of context-free grammars can be sampled";
+		return false;
+	}
+
+	tables = SampleTables();
+	tables.maxLength = maxLength;
+	const size_t width = (size_t)maxLength + 1, nonTerminalCount = gram.nonTerminals.size();
+	tables.counts.assign(nonTerminalCount * width, 0.0);
+	tables.restStarts.resize(RuleCount(gram) + 1, 0);
+	for (size_t i = 0; i < RuleCount(gram); i++) {
+		tables.restStarts[i + 1] = tables.restStarts[i] + GetRule(gram, i).rightLength + 1; // the last row is the empty rest
+	}
+	tables.rests.assign(tables.restStarts.back() * width, 0.0);
+	for (size_t i = 0; i < RuleCount(gram); i++) {
+		tables.rests[((size_t)tables.restStarts[i] + GetRule(gram, i).rightLength) * width] = 1.0;
+	}
+
+	tables.ruleStarts.assign(nonTerminalCount + 1, 0);
+	tables.rules.resize(RuleCount(gram));
+	for (size_t i = 0; i < RuleCount(gram); i++) {
+		tables.ruleStarts[GetRule(gram, i).left[0] + 1]++;
+	}
+	for (size_t i = 1; i < tables.ruleStarts.size(); i++) {
+		tables.ruleStarts[i] += tables.ruleStarts[i - 1];
+	}
+	std::vector<uint32_t> fill(tables.ruleStarts.begin(), tables.ruleStarts.end() - 1);
+	for (size_t i = 0; i < RuleCount(gram); i++) {
+		tables.rules[fill[GetRule(gram, i).left[0]]++] = (uint32_t)i;
+	}
+
+	// A -> B counts what B has of the same length, so B has to be counted first: a topological order of the unit rules,
+	// which have no cycles once the grammar is simplified
+	std::vector<uint32_t> order, stack, next(tables.ruleStarts.begin(), tables.ruleStarts.end() - 1);
+	std::vector<uint8_t> state(nonTerminalCount, 0); // 0 unseen, 1 on the stack, 2 done
+	for (uint32_t root = 0; root < nonTerminalCount; root++) {
+		if (state[root] != 0) {
+			continue;
+		}
+		stack.assign(1, root);
+		state[root] = 1;
+		while (!stack.empty()) {
+			const uint32_t nonTerminal = stack.back();
+			if (next[nonTerminal] == tables.ruleStarts[nonTerminal + 1]) {
+				stack.pop_back();
+				state[nonTerminal] = 2;
+				order.push_back(nonTerminal);
+				continue;
+			}
+
+			RuleView rule = GetRule(gram, tables.rules[next[nonTerminal]++]);
+			if (IsUnitRule(rule)) {
+				if (state[rule.right[0]] == 1) {
+					error = "the unit rules of the grammar go round in circles";
+					return false;
+				}
+				if (state[rule.right[0]] == 0) {
+					state[rule.right[0]] = 1;
+					stack.push_back(rule.right[0]);
+				}
+			}
+		}
+	}
+
+	for (uint32_t length = 0; length <= maxLength; length++) {
+		// first every rule as a whole, which only needs shorter lengths, except for unit rules
+		for (std::vector<uint32_t>::const_iterator it = order.begin(); it != order.end(); it++) {
+			double total = 0.0;
+			for (uint32_t i = tables.ruleStarts[*it]; i < tables.ruleStarts[*it + 1]; i++) {
+				const uint32_t ruleIndex = tables.rules[i];
+				RuleView rule = GetRule(gram, ruleIndex);
+				double count = 0.0;
+				if (rule.rightLength == 0) {
+					count = (length == 0) ? 1.0 : 0.0;
+				}
+				else if (rule.rightLength == 1) {
+					count = SymbolDerivations(tables, rule.right[0], length);
+				}
+				else {
+					for (uint32_t first = 1; first < length; first++) { // every symbol derives at least one terminal
+						count += SymbolDerivations(tables, rule.right[0], first) * RestDerivations(tables, ruleIndex, 1, length - first);
+					}
+				}
+				tables.rests[(size_t)tables.restStarts[ruleIndex] * width + length] = count;
+				total += count;
+			}
+			if (std::isinf(total)) {
+				error = "the grammar has too many derivations of length " + std::to_string(length) + " to count";
+				return false;
+			}
+			tables.counts[(size_t)*it * width + length] = total;
+		}
+
+		// then the rests of the rules, from the back
+		for (size_t ruleIndex = 0; ruleIndex < RuleCount(gram); ruleIndex++) {
+			RuleView rule = GetRule(gram, ruleIndex);
+			for (uint32_t offset = rule.rightLength; offset-- > 1;) {
+				double count = 0.0;
+				if (offset == rule.rightLength - 1) {
+					count = SymbolDerivations(tables, rule.right[offset], length);
+				}
+				else {
+					for (uint32_t first = 1; first < length; first++) {
+						count += SymbolDerivations(tables, rule.right[offset], first) * RestDerivations(tables, (uint32_t)ruleIndex, offset + 1, length - first);
+					}
+				}
+				tables.rests[((size_t)tables.restStarts[ruleIndex] + offset) * width + length] = count;
+			}
+		}
+	}
+
+	return true;
+}
+
+template <typename Weight>
+uint32_t PickWeighted(std::mt19937_64& random, uint32_t count, double total, Weight weight) {
+	// one of 0 .. count - 1, each as likely as its weight, the weights adding up to total
+	double pick = std::uniform_real_distribution<double>(0.0, total)(random);
+	uint32_t last = 0;
+	for (uint32_t i = 0; i < count; i++) {
+		const double current = weight(i);
+		if (current > 0.0) {
+			last = i;
+			if (pick < current) {
+				return i;
+			}
+			pick -= current;
+		}
+	}
+	return last; // rounding can leave a little over at the end
+}
+
+void SampleWord(const EnumerationGrammar& enumeration, const SampleTables& tables, std::mt19937_64& random, uint32_t length, std::vector<uint32_t>& word) {
+	// a derivation of a word of the given length from the starting point, every one of them as likely as the others
+	const Grammar& gram = enumeration.gram;
+	word.clear();
+	std::vector<std::pair<Symbol, uint32_t>> stack(1, std::make_pair(gram.startingPoint, length)), parts; // symbols still to derive, and how long
+	while (!stack.empty()) {
+		const Symbol symbol = stack.back().first;
+		uint32_t remaining = stack.back().second;
+		stack.pop_back();
+		if (IsTerminal(symbol)) {
+			word.push_back(symbol);
+			continue;
+		}
+
+		const uint32_t firstRule = tables.ruleStarts[symbol];
+		const uint32_t ruleIndex = tables.rules[firstRule + PickWeighted(random, tables.ruleStarts[symbol + 1] - firstRule, SymbolDerivations(tables, symbol, remaining),
+			[&](uint32_t i) { return RestDerivations(tables, tables.rules[firstRule + i], 0, remaining); })];
+
+		// how much of the length every symbol of the rule gets
+		RuleView rule = GetRule(gram, ruleIndex);
+		parts.clear();
+		for (uint32_t offset = 0; offset < rule.rightLength; offset++) {
+			uint32_t part = remaining;
+			if (offset + 1 < rule.rightLength) {
+				part = PickWeighted(random, remaining + 1, RestDerivations(tables, ruleIndex, offset, remaining),
+					[&](uint32_t first) { return SymbolDerivations(tables, rule.right[offset], first) * RestDerivations(tables, ruleIndex, offset + 1, remaining - first); });
+			}
+			parts.push_back(std::make_pair(rule.right[offset], part));
+			remaining -= part;
+		}
+		stack.insert(stack.end(), parts.rbegin(), parts.rend());
+	}
+}
+
+bool SampleLanguage(const EnumerationGrammar& enumeration, uint32_t maxLength, size_t count, uint64_t seed, std::ostream& output, std::string& error) {
+	// count words up to maxLength, every derivation being as likely as any other, so every word is, if the grammar is unambiguous
+	SampleTables tables;
+	if (!BuildSampleTables(enumeration, maxLength, tables, error)) {
+		return false;
+	}
+
+	const Grammar& gram = enumeration.gram;
+	double total = enumeration.acceptsEmptyWord ? 1.0 : 0.0;
+	for (uint32_t length = 1; length <= maxLength && RuleCount(gram) > 0; length++) {
+		total += SymbolDerivations(tables, gram.startingPoint, length);
+	}
+	if (total == 0.0) {
+		error = "the language has no words up to that length";
+		return false;
+	}
+
+	std::mt19937_64 random(seed);
+	std::string buffer;
+	std::vector<uint32_t> word;
+	for (size_t i = 0; i < count; i++) {
+		const uint32_t length = PickWeighted(random, maxLength + 1, total, [&](uint32_t l) {
+			return (l == 0) ? (enumeration.acceptsEmptyWord ? 1.0 : 0.0) : SymbolDerivations(tables, gram.startingPoint, l);
+		});
+		if (length == 0) {
+			word.clear();
+		}
+		else {
+			SampleWord(enumeration, tables, random, length, word);
+		}
+
+		AppendWord(buffer, enumeration, word.data(), word.size());
+		if (buffer.size() >= LoadChunkSize) {
+			output << buffer;
+			buffer.clear();
+		}
+	}
+	output << buffer;
+
+	return true;
+}
+
+int RunEnumeration(int argc, char* argv[]) {
+	// main --enumerate [--jobs N] <grammar file> <max length>: every word up to the length, shorter ones first
+	// main --sample [--seed N] <grammar file> <max length> <count>: random words up to the length, of a context-free grammar
+	const bool sample = strcmp(argv[1], "--sample") == 0;
+	unsigned jobs = std::thread::hardware_concurrency();
+	uint64_t seed = 1;
+	int argument = 2;
+	for (; argument + 1 < argc && argv[argument][0] == '-' && argv[argument][1] == '-'; argument += 2) {
+		if (strcmp(argv[argument], "--jobs") == 0) {
+			jobs = (unsigned)atoi(argv[argument + 1]);
+		}
+		else if (strcmp(argv[argument], "--seed") == 0) {
+			seed = (uint64_t)strtoull(argv[argument + 1], nullptr, 10);
+		}
+	}
+	if (argc - argument != (sample ? 3 : 2)) {
+		std::cerr << "usage: " << argv[0] << " --enumerate [--jobs N] <grammar file> <max length>\n"
+				  << "       " << argv[0] << " --sample [--seed N] <grammar file> <max length> <count>\n";
+		return 1;
+	}
+
+	Grammar gram;
+	EnumerationGrammar enumeration;
+	std::string error;
+	if (!LoadGrammarFile(argv[argument], gram, error) || !PrepareEnumeration(gram, enumeration, error)) {
+		std::cerr << error << '\n';
+		return 1;
+	}
+
+	std::ios::sync_with_stdio(false);
+	const uint32_t maxLength = (uint32_t)atoi(argv[argument + 1]);
+	if (!sample) {
+		EnumerateLanguage(enumeration, maxLength, std::max(jobs, 1u), std::cout);
+	}
+	else if (!SampleLanguage(enumeration, maxLength, (size_t)atoll(argv[argument + 2]), seed, std::cout, error)) {
+		std::cerr << error << '\n';
+		return 1;
+	}
+
+	return 0;
+}
+
+// Derivation search functions
+
+/*	Grammars of type 1 and 0 have no parser of their own, so a word is looked for by applying the rules to sentential forms,
+	breadth first from the starting point, every form being visited once. The rules of a type 1 grammar never shrink a form,
+	so forms longer than the word are dropped and the search is exact; type 0 forms may only get a little longer than the word,
+	and then not finding the word only means it's not derived within those bounds. Terminals that are on no left side never change,
+	so a form whose such terminals don't fit into the word is dropped as well.
+*/
+
+const size_t DefaultSearchForms = 1 << 22; // how many forms a search visits at most, unless told otherwise
+const uint32_t DefaultSearchSlack = 4; // how much longer than the word a form of a type 0 grammar may get, unless told otherwise
+const uint64_t NoForm = ~(uint64_t)0;
+
+struct RulePatterns { // an Aho-Corasick automaton over the left sides of the rules, finding every place any rule applies in one pass over a form
+	std::vector<uint64_t> edgeKeys; // open addressing over (node << 32 | symbol), NoTrieEdge marks a free slot
+	std::vector<uint32_t> edgeChildren,
+						  fallbacks, // the node of the longest proper suffix of a node's path that is a path too
+						  outputs, // the nearest node along the fallbacks where some left side ends, 0 if there is none
+						  ruleStarts, // the left sides of rules[ruleStarts[n] .. ruleStarts[n + 1]) end at node n
+						  rules;
+	std::vector<uint8_t> permanent; // for every terminal, whether it is on no left side and so stays wherever it is
+};
+
+struct SearchLimits {
+	size_t maxForms = DefaultSearchForms;
+	uint32_t slack = DefaultSearchSlack;
+};
+
+enum class SearchResult {
+	Derived,
+	NotDerived,
+	GaveUp // a limit was reached before the word was found
+};
+
+struct DerivationStep { // rule applied at position of the form parent
+	uint64_t parent;
+	uint32_t rule,
+			 position;
+};
+
+struct DerivationSearch { // every form seen, and how it was reached, see FormId
+	FormSet forms;
+	std::vector<DerivationStep> steps[FormShardCount];
+};
+
+inline uint64_t FormId(size_t shard, size_t index) {
+	return (uint64_t)index * FormShardCount + shard;
+}
+
+inline uint64_t PatternEdgeKey(uint32_t node, Symbol symbol) {
+	return ((uint64_t)node << 32) | symbol;
+}
+
+size_t PatternEdgeSlot(const RulePatterns& patterns, uint64_t key) {
+	const size_t mask = patterns.edgeKeys.size() - 1;
+	size_t slot = (size_t)((key * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+	while (patterns.edgeKeys[slot] != key && patterns.edgeKeys[slot] != NoTrieEdge) {
+		slot = (slot + 1) & mask;
+	}
+
+	return slot;
+}
+
+uint32_t FindPatternChild(const RulePatterns& patterns, uint32_t node, Symbol symbol) {
+	// 0 if there is no such edge, the root is nobody's child
+	const size_t slot = PatternEdgeSlot(patterns, PatternEdgeKey(node, symbol));
+	return (patterns.edgeKeys[slot] == NoTrieEdge) ? 0 : patterns.edgeChildren[slot];
+}
+
+void BuildRulePatterns(const Grammar& gram, RulePatterns& patterns) {
+	patterns = RulePatterns();
+	size_t slotCount = 16;
+	while (slotCount < 2 * RuleSymbolCount(gram)) { // at most half full, there are no more edges than symbols on the left sides
+		slotCount *= 2;
+	}
+	patterns.edgeKeys.assign(slotCount, NoTrieEdge);
+	patterns.edgeChildren.assign(slotCount, 0);
+	patterns.permanent.assign(gram.terminals.size(), 1);
+
+	std::vector<uint32_t> parents(1, 0), depths(1, 0), ends(RuleCount(gram));
+	std::vector<Symbol> edgeSymbols(1, NoSymbol); // the symbol of the edge into every node
+	for (size_t i = 0; i < RuleCount(gram); i++) {
+		RuleView rule = GetRule(gram, i);
+		uint32_t node = 0;
+		for (uint32_t j = 0; j < rule.leftLength; j++) {
+			if (IsTerminal(rule.left[j])) {
+				patterns.permanent[SymbolIndex(rule.left[j])] = 0;
+			}
+
+			const size_t slot = PatternEdgeSlot(patterns, PatternEdgeKey(node, rule.left[j]));
+			if (patterns.edgeKeys[slot] == NoTrieEdge) {
+				patterns.edgeKeys[slot] = PatternEdgeKey(node, rule.left[j]);
+				patterns.edgeChildren[slot] = (uint32_t)parents.size();
+				parents.push_back(node);
+				depths.push_back(depths[node] + 1);
+				edgeSymbols.push_back(rule.left[j]);
+			}
+			node = patterns.edgeChildren[slot];
+		}
+		ends[i] = node;
+	}
+
+	const size_t nodeCount = parents.size();
+	patterns.ruleStarts.assign(nodeCount + 1, 0);
+	for (std::vector<uint32_t>::const_iterator it = ends.begin(); it != ends.end(); it++) {
+		patterns.ruleStarts[*it + 1]++;
+	}
+	for (size_t i = 1; i < patterns.ruleStarts.size(); i++) {
+		patterns.ruleStarts[i] += patterns.ruleStarts[i - 1];
+	}
+	patterns.rules.resize(ends.size());
+	std::vector<uint32_t> fill(patterns.ruleStarts.begin(), patterns.ruleStarts.end() - 1);
+	for (size_t i = 0; i < ends.size(); i++) {
+		patterns.rules[fill[ends[i]]++] = (uint32_t)i;
+	}
+
+	// the fallbacks of shallower nodes are needed first, so the nodes go by depth
+	std::vector<uint32_t> order(nodeCount);
+	for (uint32_t i = 0; i < nodeCount; i++) {
+		order[i] = i;
+	}
+	std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return depths[a] < depths[b]; });
+
+	patterns.fallbacks.assign(nodeCount, 0);
+	patterns.outputs.assign(nodeCount, 0);
+	for (std::vector<uint32_t>::const_iterator it = order.begin(); it != order.end(); it++) {
+		if (parents[*it] == 0) { // the root and its children fall back to the root
+			continue;
+		}
+
+		uint32_t fallback = patterns.fallbacks[parents[*it]];
+		while (fallback != 0 && FindPatternChild(patterns, fallback, edgeSymbols[*it]) == 0) {
+			fallback = patterns.fallbacks[fallback];
+		}
+		fallback = FindPatternChild(patterns, fallback, edgeSymbols[*it]);
+		patterns.fallbacks[*it] = fallback;
+		patterns.outputs[*it] = (patterns.ruleStarts[fallback] != patterns.ruleStarts[fallback + 1]) ? fallback : patterns.outputs[fallback];
+	}
+}
+
+template <typename Match>
+void MatchRulePatterns(const RulePatterns& patterns, const Grammar& gram, const std::vector<uint32_t>& form, Match match) {
+	// calls match(rule, position) for every rule whose left side is in the form at position
+	uint32_t node = 0;
+	for (size_t i = 0; i < form.size(); i++) {
+		uint32_t child = FindPatternChild(patterns, node, form[i]);
+		while (node != 0 && child == 0) {
+			node = patterns.fallbacks[node];
+			child = FindPatternChild(patterns, node, form[i]);
+		}
+		node = child;
+
+		for (uint32_t end = (patterns.ruleStarts[node] != patterns.ruleStarts[node + 1]) ? node : patterns.outputs[node]; end != 0; end = patterns.outputs[end]) {
+			for (uint32_t j = patterns.ruleStarts[end]; j < patterns.ruleStarts[end + 1]; j++) {
+				match(patterns.rules[j], (uint32_t)(i + 1 - GetRule(gram, patterns.rules[j]).leftLength));
+			}
+		}
+	}
+}
+
+bool FitsIntoWord(const RulePatterns& patterns, const std::vector<uint32_t>& form, const Symbol* word, size_t length) {
+	// the terminals that never change have to show up in the word in the same order, and the ones the form starts
+	// or ends with right there, as nothing can get in front of or behind them anymore
+	size_t front = 0, back = 0;
+	while (front < form.size() && IsTerminal(form[front]) && patterns.permanent[SymbolIndex(form[front])]) {
+		if (front >= length || word[front] != form[front]) {
+			return false;
+		}
+		front++;
+	}
+	if (front == form.size()) {
+		return front == length;
+	}
+	while (back < form.size() - front && IsTerminal(form[form.size() - 1 - back]) && patterns.permanent[SymbolIndex(form[form.size() - 1 - back])]) {
+		if (front + back >= length || word[length - 1 - back] != form[form.size() - 1 - back]) {
+			return false;
+		}
+		back++;
+	}
+
+	size_t position = front;
+	for (size_t i = front; i < form.size() - back; i++) {
+		if (IsTerminal(form[i]) && patterns.permanent[SymbolIndex(form[i])]) {
+			while (position < length - back && word[position] != form[i]) {
+				position++;
+			}
+			if (position == length - back) {
+				return false;
+			}
+			position++;
+		}
+	}
+
+	return true;
+}
+
+uint64_t AddSearchForm(DerivationSearch& search, const std::vector<uint32_t>& form, const DerivationStep& step, bool& added) {
+	const size_t shard = FormShard(form);
+	std::lock_guard<std::mutex> lock(search.forms.locks[shard]);
+	const size_t count = SequenceCount(search.forms.shards[shard]);
+	const size_t index = FindOrAddSequence(search.forms.shards[shard], form);
+	added = index == count;
+	if (added) {
+		search.steps[shard].push_back(step);
+	}
+
+	return FormId(shard, index);
+}
+
+SearchResult SearchDerivation(const Grammar& gram, const RulePatterns& patterns, const Symbol* word, size_t length,
+	const SearchLimits& limits, unsigned threads, std::vector<DerivationStep>& derivation) {
+	// looks for the word breadth first, so the derivation, rule and position of every step, is one of the shortest
+	derivation.clear();
+	if (gram.startingPoint == NoSymbol) {
+		return SearchResult::NotDerived;
+	}
+
+	// only rules that shrink a form make dropping long forms a guess, the empty word rule of a starting point on no right side aside
+	bool startOnRightSide = false, shrinks = false;
+	for (size_t i = 0; i < RuleCount(gram); i++) {
+		RuleView rule = GetRule(gram, i);
+		startOnRightSide = startOnRightSide || std::find(rule.right, rule.right + rule.rightLength, gram.startingPoint) != rule.right + rule.rightLength;
+	}
+	for (size_t i = 0; i < RuleCount(gram); i++) {
+		RuleView rule = GetRule(gram, i);
+		const bool startEmptyRule = rule.rightLength == 0 && rule.leftLength == 1 && rule.left[0] == gram.startingPoint && !startOnRightSide;
+		shrinks = shrinks || (rule.rightLength < rule.leftLength && !startEmptyRule);
+	}
+	const size_t maxLength = length + (shrinks ? limits.slack : 0);
+
+	std::unique_ptr<DerivationSearch> search(new DerivationSearch()); // far too big for the stack
+	const std::vector<uint32_t> target(word, word + length);
+	bool added = false;
+	std::vector<uint64_t> frontier(1, AddSearchForm(*search, std::vector<uint32_t>(1, gram.startingPoint), { NoForm, 0, 0 }, added)), next;
+	std::atomic<size_t> formCount(1);
+	std::atomic<uint64_t> found(NoForm);
+	std::atomic<bool> dropped(false), gaveUp(false);
+
+	while (!frontier.empty() && found == NoForm && !gaveUp) {
+		std::atomic<size_t> nextChunk(0);
+		const size_t chunkCount = (frontier.size() + EnumerationChunk - 1) / EnumerationChunk;
+		std::vector<std::vector<uint64_t>> reached(std::max(1u, threads)); // what every thread adds to the next frontier
+		auto expandChunks = [&](std::vector<uint64_t>& reachedHere) {
+			std::vector<uint32_t> form, expanded;
+			for (size_t chunk = nextChunk++; chunk < chunkCount && found == NoForm && !gaveUp; chunk = nextChunk++) {
+				const size_t end = std::min(frontier.size(), (chunk + 1) * EnumerationChunk);
+				for (size_t i = chunk * EnumerationChunk; i < end; i++) {
+					CopyForm(search->forms, (size_t)(frontier[i] % FormShardCount), (size_t)(frontier[i] / FormShardCount), form);
+					MatchRulePatterns(patterns, gram, form, [&](uint32_t ruleIndex, uint32_t position) {
+						RuleView rule = GetRule(gram, ruleIndex);
+						if (form.size() - rule.leftLength + rule.rightLength > maxLength) {
+							dropped = true;
+							return;
+						}
+
+						expanded.assign(form.begin(), form.begin() + position);
+						expanded.insert(expanded.end(), rule.right, rule.right + rule.rightLength);
+						expanded.insert(expanded.end(), form.begin() + position + rule.leftLength, form.end());
+						if (!FitsIntoWord(patterns, expanded, word, length)) {
+							return;
+						}
+
+						bool addedHere = false;
+						const uint64_t id = AddSearchForm(*search, expanded, { frontier[i], ruleIndex, position }, addedHere);
+						if (!addedHere) {
+							return;
+						}
+						if (expanded == target) {
+							uint64_t none = NoForm;
+							found.compare_exchange_strong(none, id);
+						}
+						if (++formCount > limits.maxForms) {
+							gaveUp = true;
+						}
+						reachedHere.push_back(id);
+					});
+				}
+			}
+		};
+
+		if (threads <= 1 || chunkCount == 1) {
+			expandChunks(reached[0]);
+		}
+		else {
+			std::vector<std::thread> workers;
+			for (unsigned i = 0; i < threads && i < chunkCount; i++) {
+				workers.emplace_back(expandChunks, std::ref(reached[i]));
+			}
+			for (std::vector<std::thread>::iterator it = workers.begin(); it != workers.end(); it++) {
+				it->join();
+			}
+		}
+
+		next.clear();
+		for (std::vector<std::vector<uint64_t>>::const_iterator it = reached.begin(); it != reached.end(); it++) {
+			next.insert(next.end(), it->begin(), it->end());
+		}
+		frontier.swap(next);
+	}
+
+	if (found == NoForm) {
+		return (gaveUp || (dropped && shrinks)) ? SearchResult::GaveUp : SearchResult::NotDerived;
+	}
+
+	for (uint64_t id = found; ; ) {
+		const DerivationStep& step = search->steps[id % FormShardCount][id / FormShardCount];
+		if (step.parent == NoForm) {
+			break;
+		}
+		derivation.push_back(step);
+		id = step.parent;
+	}
+	std::reverse(derivation.begin(), derivation.end());
+
+	return SearchResult::Derived;
+}
+
+void PrintDerivation(const Grammar& gram, const std::vector<DerivationStep>& derivation) {
+	// S => ... => the word, every form after applying one more step
+	std::vector<Symbol> form(1, gram.startingPoint), expanded;
+	PrintRuleSide(gram, form.data(), (uint32_t)form.size());
+	for (std::vector<DerivationStep>::const_iterator it = derivation.begin(); it != derivation.end(); it++) {
+		RuleView rule = GetRule(gram, it->rule);
+		expanded.assign(form.begin(), form.begin() + it->position);
+		expanded.insert(expanded.end(), rule.right, rule.right + rule.rightLength);
+		expanded.insert(expanded.end(), form.begin() + it->position + rule.leftLength, form.end());
+		form.swap(expanded);
+
+		std::cout << " => ";
+		PrintRuleSide(gram, form.data(), (uint32_t)form.size());
+	}
+}
+
+void DeriveWords(const Grammar& gram, char* const* words, int wordCount, bool printDerivations, const SearchLimits* limits, unsigned jobs) {
+	// writes whether every word is derived, or how, the default limits and every core being used unless told otherwise
+	const SearchLimits defaultLimits;
+	limits = limits ? limits : &defaultLimits;
+	jobs = jobs ? jobs : std::max(std::thread::hardware_concurrency(), 1u);
+
+	std::string error;
+	RulePatterns patterns;
+	BuildRulePatterns(gram, patterns);
+	std::vector<Symbol> word;
+	std::vector<DerivationStep> derivation;
+	for (int i = 0; i < wordCount; i++) {
+		std::cout << words[i] << ": ";
+		if (!SplitWord(gram, words[i], word, error)) {
+			std::cout << error << '\n';
+			continue;
+		}
+
+		switch (SearchDerivation(gram, patterns, word.data(), word.size(), *limits, jobs, derivation)) {
+			case SearchResult::Derived: {
+				if (printDerivations) {
+					PrintDerivation(gram, derivation);
+				}
+				else {
+					std::cout << "yes";
+				}
+				std::cout << '\n';
+				break;
+			}
+			case SearchResult::NotDerived: {
+				std::cout << "no\n";
+				break;
+			}
+			case SearchResult::GaveUp: {
+				std::cout << "not found within the limits\n";
+				break;
+			}
+		}
+	}
+}
+
+int RunDerivationSearch(int argc, char* argv[]) {
+	// main --derive [--jobs N] [--forms N] [--slack N] <grammar file> <word>...: a derivation of every word of the language,
+	// for a grammar of any type, though it's meant for those of type 1 and 0, which --member and --parse hand over to it
+	unsigned jobs = std::thread::hardware_concurrency();
+	SearchLimits limits;
+	int argument = 2;
+	for (; argument + 1 < argc && argv[argument][0] == '-' && argv[argument][1] == '-'; argument += 2) {
+		if (strcmp(argv[argument], "--jobs") == 0) {
+			jobs = (unsigned)atoi(argv[argument + 1]);
+		}
+		else if (strcmp(argv[argument], "--forms") == 0) {
+			limits.maxForms = (size_t)atoll(argv[argument + 1]);
+		}
+		else if (strcmp(argv[argument], "--slack") == 0) {
+			limits.slack = (uint32_t)atoi(argv[argument + 1]);
+		}
+	}
+	if (argument >= argc) {
+		std::cerr << "usage: " << argv[0] << " --derive [--jobs N] [--forms N] [--slack N] <grammar file> <word>...\n";
+		return 1;
+	}
+
+	Grammar gram;
+	std::string error;
+	if (!LoadGrammarFile(argv[argument], gram, error)) {
+		std::cerr << error << '\n';
+		return 1;
+	}
+
+	DeriveWords(gram, argv + argument + 1, argc - argument - 1, true, &limits, jobs);
+
+	return 0;
+}
+
+// Batch functions
+
+struct BatchResult {
+	std::string path;
+	bool loaded = false;
+	std::string error;
+	GrammarType type = GrammarType::TypeNULL;
+	size_t ruleCount = 0;
+	double loadMilliseconds = 0,
+		   classifyMilliseconds = 0;
+};
+
+const char* GrammarTypeName(GrammarType type) {
+	switch (type) {
+		case GrammarType::Type0: return "Type0";
+		case GrammarType::Type1: return "Type1";
+		case GrammarType::Type2: return "Type2";
+		case GrammarType::Type3: return "Type3";
+		default: return "TypeNULL";
+	}
+}
+
+double MillisecondsSince(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void ClassifyFile(BatchResult& result, unsigned threads) {
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	// binary grammars already carry their type, text ones are classified after loading
+	Grammar gram;
+	const bool binary = IsBinaryGrammarFile(result.path);
+	result.loaded = binary ? LoadGrammarBinary(result.path, gram, &result.type, result.error) : LoadGrammarFile(result.path, gram, result.error);
+	result.loadMilliseconds = MillisecondsSince(start);
+	if (!result.loaded) {
+		return;
+	}
+
+	result.ruleCount = RuleCount(gram);
+	if (!binary) {
+		start = std::chrono::steady_clock::now();
+		result.type = FindGrammarTypeParallel(gram, threads);
+		result.classifyMilliseconds = MillisecondsSince(start);
+	}
+}
+
+void ClassifyFiles(std::vector<BatchResult>& results, unsigned jobs) {
+	// every worker keeps claiming the next unclassified file, so slow grammars don't hold the others back
+	// with fewer files than threads, the spare threads help classify every single file
+	const unsigned threadsPerFile = (results.size() < jobs) ? jobs / (unsigned)std::max<size_t>(results.size(), 1) : 1;
+	std::atomic<size_t> next(0);
+	std::vector<std::thread> workers;
+	for (unsigned i = 0; i < jobs && i < results.size(); i++) {
+		workers.emplace_back([&results, &next, threadsPerFile]() {
+			for (size_t job = next++; job < results.size(); job = next++) {
+				ClassifyFile(results[job], threadsPerFile);
+			}
+		});
+	}
+
+	for (std::vector<std::thread>::iterator it = workers.begin(); it != workers.end(); it++) {
+		it->join();
+	}
+}
+
+std::string EscapeJson(const std::string& str) {
+	std::string escaped;
+	for (std::string::const_iterator it = str.begin(); it != str.end(); it++) {
+		if (*it == '"' || *it == '\\') {
+			escaped.push_back('\\');
+			escaped.push_back(*it);
+		}
+		else if ((unsigned char)*it < 0x20) {
+			char code[8];
+			snprintf(code, sizeof(code), "\\u%04x", (unsigned char)*it);
+			escaped += code;
+		}
+		else {
+			escaped.push_back(*it);
+		}
+	}
+
+	return escaped;
+}
+
+std::string EscapeCsv(const std::string& str) {
+	if (str.find_first_of(",\"\r\n") == std::string::npos) {
+		return str;
+	}
+
+	std::string escaped = "\"";
+	for (std::string::const_iterator it = str.begin(); it != str.end(); it++) {
+		if (*it == '"') {
+			escaped.push_back('"');
+		}
+		escaped.push_back(*it);
+	}
+
+	return escaped + "\"";
+}
+
+void PrintBatchResults(std::ostream& output, const std::vector<BatchResult>& results, bool json) {
+	if (!json) {
+		output << "path,type,rules,load_ms,classify_ms,error\n";
+	}
+
+	for (std::vector<BatchResult>::const_iterator it = results.begin(); it != results.end(); it++) {
+		const char* type = it->loaded ? GrammarTypeName(it->type) : "error";
+		if (json) {
+			output << "{\"path\":\"" << EscapeJson(it->path) << "\",\"type\":\"" << type << "\",\"rules\":" << it->ruleCount
+				   << ",\"load_ms\":" << it->loadMilliseconds << ",\"classify_ms\":" << it->classifyMilliseconds;
+			if (!it->loaded) {
+				output << ",\"error\":\"" << EscapeJson(it->error) << "\"";
+			}
+			output << "}\n";
+		}
+		else {
+			output << EscapeCsv(it->path) << ',' << type << ',' << it->ruleCount << ',' << it->loadMilliseconds << ','
+				   << it->classifyMilliseconds << ',' << EscapeCsv(it->error) << '\n';
+		}
+	}
+}
+
+int RunBatch(int argc, char* argv[]) {
+	// main --classify [--jobs N] [--json] <file or directory>...
+	unsigned jobs = std::thread::hardware_concurrency();
+	bool json = false;
+	std::vector<BatchResult> results;
+
+	for (int i = 2; i < argc; i++) {
+		if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+			jobs = (unsigned)atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--json") == 0) {
+			json = true;
+		}
+		else if (strcmp(argv[i], "--csv") == 0) {
+			json = false;
+		}
+		else if (std::filesystem::is_directory(argv[i])) { // every file in the directory and its subdirectories
+			std::vector<std::string> paths;
+			for (std::filesystem::recursive_directory_iterator it(argv[i]), end; it != end; it++) {
+				if (it->is_regular_file()) {
+					paths.push_back(it->path().string());
+				}
+			}
+
+			std::sort(paths.begin(), paths.end());
+			for (std::vector<std::string>::iterator it = paths.begin(); it != paths.end(); it++) {
+				results.emplace_back();
+				results.back().path = *it;
+			}
+		}
+		else {
+			results.emplace_back();
+			results.back().path = argv[i];
+		}
+	}
+
+	if (jobs == 0) {
+		jobs = 1;
+	}
+
+	ClassifyFiles(results, jobs);
+	PrintBatchResults(std::cout, results, json);
+
+	for (std::vector<BatchResult>::const_iterator it = results.begin(); it != results.end(); it++) {
+		if (!it->loaded) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+// Benchmark functions
+
+const size_t BenchmarkRuleTarget = 1000000; // small grammars are run again and again until about this many rules went through the operation
+
+struct SyntheticGrammarOptions {
+	GrammarType type = GrammarType::Type3;
+	size_t ruleCount = 10000,
+		   nonTerminalCount = 0, // one for every 100 rules when 0
+		   alphabetSize = 2,
+		   nameLength = 1; // how long the names are at least, non-terminals start with a capital letter and terminals don't
+	double collisionRate = 0.0; // how many of the non-terminal names every grammar with these options has, whatever its seed
+	uint64_t seed = 1;
+};
+
+std::string SyntheticName(char first, uint64_t index, size_t length) {
+	// first, then index in base 26 written with lowercase letters, padded with a's up to length
+	std::string digits;
+	do {
+		digits += (char)('a' + index % 26);
+		index /= 26;
+	} while (index > 0);
+	while (digits.size() + (first ? 1 : 0) < length) {
+		digits += 'a';
+	}
+
+	std::reverse(digits.begin(), digits.end());
+	return first ? first + digits : digits;
+}
+
+Grammar GenerateSyntheticGrammar(const SyntheticGrammarOptions& options) {
+	// every non-terminal gets a rule that ends the word first, the other rules are made to be exactly of the type asked for:
+	// type 3 only has N -> a M, type 2 adds N -> M a M', type 1 adds a context (u N v -> u w v) and type 0 rules that shrink
+	std::mt19937_64 random(options.seed);
+	Grammar gram;
+	const size_t nonTerminalCount = std::max<size_t>(options.nonTerminalCount ? options.nonTerminalCount : options.ruleCount / 100, 2),
+				 alphabetSize = std::max<size_t>(options.alphabetSize, 1);
+
+	std::vector<Symbol> terminals;
+	for (size_t i = 0; i < alphabetSize; i++) {
+		terminals.push_back(AddTerminal(gram, SyntheticName('\0', i, options.nameLength)));
+	}
+	std::bernoulli_distribution shared(options.collisionRate);
+	for (size_t i = 0; i < nonTerminalCount; i++) {
+		if (shared(random)) {
+			AddNonTerminal(gram, SyntheticName('N', i, options.nameLength));
+			continue;
+		}
+
+		std::string name;
+		do { // a name of its own, which can only clash with one we already have
+			name = SyntheticName('P', random() & 0xFFFFFFFFFFull, options.nameLength);
+		} while (FindSymbol(gram, name) != NoSymbol);
+		AddNonTerminal(gram, name);
+	}
+	gram.startingPoint = 0;
+
+	auto anyTerminal = [&]() { return terminals[random() % terminals.size()]; };
+	auto anyNonTerminal = [&]() { return (Symbol)(random() % nonTerminalCount); };
+	auto anySymbol = [&]() { return (random() % 2) ? anyTerminal() : anyNonTerminal(); };
+
+	ReserveGrammar(gram, nonTerminalCount + alphabetSize, options.ruleCount, 5 * options.ruleCount);
+	std::vector<Symbol> left, right;
+	for (size_t i = 0; i < options.ruleCount; i++) {
+		const Symbol nonTerminal = (Symbol)(i % nonTerminalCount);
+		left.assign(1, nonTerminal);
+		right.clear();
+		if (i < nonTerminalCount) {
+			right.push_back(anyTerminal());
+		}
+		else if (options.type == GrammarType::Type3 || i % 4 == 0) {
+			right.push_back(anyTerminal());
+			right.push_back(anyNonTerminal());
+		}
+		else if (options.type == GrammarType::Type2 || i % 4 == 1) {
+			right.push_back(anyNonTerminal());
+			right.push_back(anyTerminal());
+			right.push_back(anyNonTerminal());
+		}
+		else if (options.type == GrammarType::Type1 || i % 4 == 2) {
+			const Symbol before = anySymbol(), after = anySymbol();
+			left.assign({ before, nonTerminal, after });
+			right.push_back(before);
+			for (size_t j = 1 + random() % 3; j > 0; j--) {
+				right.push_back(anySymbol());
+			}
+			right.push_back(after);
+		}
+		else {
+			left.push_back(anySymbol());
+			right.push_back(anySymbol());
+		}
+
+		AddProductionRule(gram, left, right);
+	}
+
+	return gram;
+}
+
+size_t PeakResidentKiB() {
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	return GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) ? counters.PeakWorkingSetSize / 1024 : 0;
+#else
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+	return (size_t)usage.ru_maxrss / 1024; // bytes on macOS, KiB everywhere else
+#else
+	return (size_t)usage.ru_maxrss;
+#endif
+#endif
+}
+
+struct BenchmarkResult {
+	std::string operation;
+	GrammarType type = GrammarType::TypeNULL;
+	size_t inputRules = 0,
+		   outputRules = 0,
+		   repetitions = 1;
+	double milliseconds = 0.0; // these and the allocations are for a single run
+	size_t allocations = 0,
+		   allocatedBytes = 0,
+		   peakResidentKiB = 0; // of the whole process so far
+};
+
+template <typename Operation>
+BenchmarkResult MeasureBenchmark(const char* name, size_t inputRules, size_t repetitions, Operation operation) {
+	BenchmarkResult result;
+	result.operation = name;
+	result.inputRules = inputRules;
+	result.repetitions = std::max<size_t>(repetitions, 1);
+
+	const size_t allocationsBefore = allocationCount, bytesBefore = allocatedBytes;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < result.repetitions; i++) {
+		result.outputRules = operation();
+	}
+	result.milliseconds = MillisecondsSince(start) / result.repetitions;
+	result.allocations = (allocationCount - allocationsBefore) / result.repetitions;
+	result.allocatedBytes = (allocatedBytes - bytesBefore) / result.repetitions;
+	result.peakResidentKiB = PeakResidentKiB();
+
+	return result;
+}
+
+template <typename Operation>
+void MeasureOperation(const char* name, Operation operation) {
+	const BenchmarkResult result = MeasureBenchmark(name, 0, 1, operation);
+	std::cout << name << ": " << result.outputRules << " rules, " << result.allocations << " allocations, "
+			  << result.allocatedBytes / 1024 << " KiB allocated, " << result.milliseconds << " ms, peak RSS " << result.peakResidentKiB << " KiB\n";
+}
+
+int RunAllocationBenchmark(size_t ruleCount) {
+	// main --bench-allocations [rules]: how much every operation allocates, composed operations included
+	SyntheticGrammarOptions options;
+	options.ruleCount = ruleCount;
+	const Grammar gram1 = GenerateSyntheticGrammar(options),
+				  gram2 = GenerateSyntheticGrammar(options);
+
+	MeasureOperation("FindGrammarType", [&]() { FindGrammarType(gram1); return RuleCount(gram1); });
+	MeasureOperation("Union", [&]() { return RuleCount(CreateGrammarFromUnion(gram1, gram2)); });
+	MeasureOperation("Product", [&]() { return RuleCount(CreateGrammarFromProduct(gram1, gram2)); });
+	MeasureOperation("Closure", [&]() { return RuleCount(CreateGrammarFromClosure(gram1)); });
+	MeasureOperation("Closure(Union(Product(g1, g2), g2))", [&]() {
+		return RuleCount(CreateGrammarFromClosure(CreateGrammarFromUnion(CreateGrammarFromProduct(gram1, gram2), gram2)));
+	});
+	MeasureOperation("Closure(Union(Product(g1, g2), g2)) as an expression", [&]() {
+		LanguageExpression expression;
+		const uint32_t first = AddGrammarExpression(expression, gram1), second = AddGrammarExpression(expression, gram2);
+		return RuleCount(CreateGrammarFromExpression(expression, AddClosureExpression(expression, AddUnionExpression(expression, AddProductExpression(expression, first, second), second))));
+	});
+
+	return 0;
+}
+
+// Expression checks, a test of CreateGrammarFromExpression against the eager operations that is only compiled with EXPRESSION_CHECKS
+
+#ifdef EXPRESSION_CHECKS
+const size_t ExpressionCheckForms = 1 << 16; // how many sentential forms a derivation search of the check may keep, words it gives up on are skipped
+
+bool FindWordDifference(const Grammar& gram1, const Grammar& gram2, uint32_t maxLength, std::string& difference) {
+	// whether some word no longer than maxLength is in only one of the languages, written to difference if so. Both grammars need the same
+	// terminals. The words are enumerated when both grammars allow it, and otherwise every word is looked for through its derivations
+	EnumerationGrammar enumeration1, enumeration2;
+	std::string error;
+	if (PrepareEnumeration(gram1, enumeration1, error) && PrepareEnumeration(gram2, enumeration2, error)) {
+		std::vector<std::string> words[2];
+		const EnumerationGrammar* enumerations[2] = { &enumeration1, &enumeration2 };
+		for (size_t i = 0; i < 2; i++) {
+			std::ostringstream output;
+			EnumerateLanguage(*enumerations[i], maxLength, 1, output);
+			std::istringstream input(output.str());
+			std::string line;
+			while (std::getline(input, line)) {
+				words[i].push_back(line);
+			}
+			std::sort(words[i].begin(), words[i].end());
+		}
+
+		std::vector<std::string> different;
+		std::set_symmetric_difference(words[0].begin(), words[0].end(), words[1].begin(), words[1].end(), std::back_inserter(different));
+		if (different.empty()) {
+			return false;
+		}
+		difference = different[0];
+		return true;
+	}
+
+	RulePatterns patterns1, patterns2;
+	BuildRulePatterns(gram1, patterns1);
+	BuildRulePatterns(gram2, patterns2);
+	SearchLimits limits;
+	limits.maxForms = ExpressionCheckForms;
+
+	const size_t terminalCount = gram1.terminals.size();
+	std::vector<uint32_t> digits; // the word as indices into the terminals of gram1, counted up like a number
+	std::vector<Symbol> word1, word2;
+	std::vector<std::string_view> names;
+	std::vector<DerivationStep> derivation;
+	for (uint32_t length = 0; length <= maxLength && (length == 0 || terminalCount > 0); length++) {
+		digits.assign(length, 0);
+		do {
+			word1.clear();
+			word2.clear();
+			names.clear();
+			for (std::vector<uint32_t>::const_iterator it = digits.begin(); it != digits.end(); it++) {
+				word1.push_back(TerminalTag | *it);
+				word2.push_back(FindSymbol(gram2, gram1.terminals[*it]));
+				names.push_back(gram1.terminals[*it]);
+			}
+
+			const SearchResult result1 = SearchDerivation(gram1, patterns1, word1.data(), word1.size(), limits, 1, derivation),
+							   result2 = SearchDerivation(gram2, patterns2, word2.data(), word2.size(), limits, 1, derivation);
+			if (result1 != SearchResult::GaveUp && result2 != SearchResult::GaveUp && result1 != result2) {
+				difference = WordText(names);
+				return true;
+			}
+
+			size_t position = 0;
+			while (position < length && ++digits[position] == terminalCount) {
+				digits[position++] = 0;
+			}
+			if (position == length) {
+				break;
+			}
+		} while (length > 0);
+	}
+
+	return false;
+}
+
+int RunExpressionCheck(size_t seedCount) {
+	// main --check-expressions [seeds], in a build with EXPRESSION_CHECKS: whether CreateGrammarFromExpression gives the words the eager operations give, over small synthetic
+	// grammars of every type used more than once in an expression, and over a grammar whose copies would rewrite each other if they were shared
+	const uint32_t maxLength = 5;
+	size_t checks = 0, differences = 0;
+	auto check = [&](const std::string& name, const Grammar& eager, const Grammar& composed) {
+		std::string difference;
+		checks++;
+		if (FindWordDifference(eager, composed, maxLength, difference)) {
+			differences++;
+			std::cout << name << ": the expression and the operations differ on " << difference << '\n';
+		}
+	};
+
+	Grammar shrinking; // its language is { a, b }, but A B -> c would make c out of two copies of it sharing A and B
+	AddNonTerminal(shrinking, "S");
+	AddNonTerminal(shrinking, "A");
+	AddNonTerminal(shrinking, "B");
+	AddTerminal(shrinking, "a");
+	AddTerminal(shrinking, "b");
+	AddTerminal(shrinking, "c");
+	shrinking.startingPoint = FindSymbol(shrinking, "S");
+	ParseProductionRule(shrinking, "S", "A");
+	ParseProductionRule(shrinking, "S", "B");
+	ParseProductionRule(shrinking, "AB", "c");
+	ParseProductionRule(shrinking, "A", "a");
+	ParseProductionRule(shrinking, "B", "b");
+	{
+		LanguageExpression expression;
+		const uint32_t operand = AddGrammarExpression(expression, shrinking);
+		check("Product(g, g) with A B -> c", CreateGrammarFromProduct(shrinking, shrinking), CreateGrammarFromExpression(expression, AddProductExpression(expression, operand, operand)));
+	}
+
+	const GrammarType types[] = { GrammarType::Type3, GrammarType::Type2, GrammarType::Type1, GrammarType::Type0 };
+	for (size_t seed = 1; seed <= seedCount; seed++) {
+		for (size_t i = 0; i < 4; i++) {
+			SyntheticGrammarOptions options;
+			options.type = types[i];
+			options.ruleCount = 8;
+			options.nonTerminalCount = 3;
+			options.seed = seed;
+			const Grammar gram1 = GenerateSyntheticGrammar(options);
+			options.seed = seed + seedCount;
+			const Grammar gram2 = GenerateSyntheticGrammar(options);
+
+			LanguageExpression expression;
+			const uint32_t first = AddGrammarExpression(expression, gram1), second = AddGrammarExpression(expression, gram2),
+						   productOfBoth = AddProductExpression(expression, first, second);
+			const std::string prefix = "seed " + std::to_string(seed) + ", " + GrammarTypeName(types[i]) + ", ";
+			check(prefix + "Product(g1, g1)", CreateGrammarFromProduct(gram1, gram1), CreateGrammarFromExpression(expression, AddProductExpression(expression, first, first)));
+			check(prefix + "Union(Product(g1, g2), g2)", CreateGrammarFromUnion(CreateGrammarFromProduct(gram1, gram2), gram2),
+				CreateGrammarFromExpression(expression, AddUnionExpression(expression, productOfBoth, second)));
+			check(prefix + "Closure(Union(Product(g1, g2), g2))", CreateGrammarFromClosure(CreateGrammarFromUnion(CreateGrammarFromProduct(gram1, gram2), gram2)),
+				CreateGrammarFromExpression(expression, AddClosureExpression(expression, AddUnionExpression(expression, productOfBoth, second))));
+			check(prefix + "Product(Closure(g1), Union(g1, g2))", CreateGrammarFromProduct(CreateGrammarFromClosure(gram1), CreateGrammarFromUnion(gram1, gram2)),
+				CreateGrammarFromExpression(expression, AddProductExpression(expression, AddClosureExpression(expression, first), AddUnionExpression(expression, first, second))));
+		}
+	}
+
+	std::cout << checks << " checks up to length " << maxLength << ", " << differences << " differences\n";
+	return (differences == 0) ? 0 : 1;
+}
+#endif
+
+void PrintBenchmarkResult(std::ostream& output, const BenchmarkResult& result, bool json) {
+	const double nanosecondsPerRule = result.inputRules ? result.milliseconds * 1e6 / result.inputRules : 0.0;
+	if (json) {
+		output << "{\"type\":\"" << GrammarTypeName(result.type) << "\",\"rules\":" << result.inputRules << ",\"operation\":\"" << EscapeJson(result.operation)
+			   << "\",\"result_rules\":" << result.outputRules << ",\"repetitions\":" << result.repetitions << ",\"ms\":" << result.milliseconds
+			   << ",\"ns_per_rule\":" << nanosecondsPerRule << ",\"allocations\":" << result.allocations << ",\"allocated_kib\":" << result.allocatedBytes / 1024
+			   << ",\"peak_rss_kib\":" << result.peakResidentKiB << "}\n";
+	}
+	else {
+		output << GrammarTypeName(result.type) << ',' << result.inputRules << ',' << EscapeCsv(result.operation) << ',' << result.outputRules << ','
+			   << result.repetitions << ',' << result.milliseconds << ',' << nanosecondsPerRule << ',' << result.allocations << ','
+			   << result.allocatedBytes / 1024 << ',' << result.peakResidentKiB << '\n';
+	}
+}
+
+int RunBenchmark(int argc, char* argv[]) {
+	// main --bench [--seed N] [--sizes N,N,...] [--types 3210] [--alphabet N] [--name-length N] [--collisions R] [--json]:
+	// FindGrammarType and the closure properties over synthetic grammars of every size and type, one line each
+	SyntheticGrammarOptions options;
+	std::vector<size_t> sizes = { 100, 10000, 1000000 };
+	std::string types = "3210";
+	bool json = false;
+
+	for (int i = 2; i < argc; i++) {
+		const bool hasValue = i + 1 < argc;
+		if (strcmp(argv[i], "--json") == 0) {
+			json = true;
+		}
+		else if (strcmp(argv[i], "--csv") == 0) {
+			json = false;
+		}
+		else if (strcmp(argv[i], "--seed") == 0 && hasValue) {
+			options.seed = (uint64_t)strtoull(argv[++i], nullptr, 10);
+		}
+		else if (strcmp(argv[i], "--sizes") == 0 && hasValue) {
+			const std::string list = argv[++i];
+			sizes.clear();
+			for (size_t start = 0; start < list.size(); ) {
+				const size_t comma = std::min(list.find(',', start), list.size());
+				sizes.push_back((size_t)strtoull(list.substr(start, comma - start).c_str(), nullptr, 10));
+				start = comma + 1;
+			}
+		}
+		else if (strcmp(argv[i], "--types") == 0 && hasValue) {
+			types = argv[++i];
+		}
+		else if (strcmp(argv[i], "--alphabet") == 0 && hasValue) {
+			options.alphabetSize = (size_t)atoll(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--name-length") == 0 && hasValue) {
+			options.nameLength = (size_t)atoll(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--collisions") == 0 && hasValue) {
+			options.collisionRate = std::min(std::max(atof(argv[++i]), 0.0), 1.0);
+		}
+		else {
+			std::cerr << "usage: " << argv[0] << " --bench [--seed N] [--sizes N,N,...] [--types 3210] [--alphabet N] [--name-length N] [--collisions R] [--json]\n";
+			return 1;
+		}
+	}
+
+	if (!json) {
+		std::cout << "type,rules,operation,result_rules,repetitions,ms,ns_per_rule,allocations,allocated_kib,peak_rss_kib\n";
+	}
+
+	const uint64_t seed = options.seed;
+	for (std::string::const_iterator type = types.begin(); type != types.end(); type++) {
+		if (*type < '0' || *type > '3') {
+			continue;
+		}
+		options.type = (GrammarType)(*type - '0');
+
+		for (std::vector<size_t>::const_iterator size = sizes.begin(); size != sizes.end(); size++) {
+			options.ruleCount = *size;
+			options.seed = seed;
+			const Grammar gram1 = GenerateSyntheticGrammar(options);
+			options.seed = seed + 1;
+			const Grammar gram2 = GenerateSyntheticGrammar(options);
+
+			const GrammarType actualType = FindGrammarType(gram1);
+			const size_t rules1 = RuleCount(gram1), rules2 = RuleCount(gram2),
+						 repetitions = BenchmarkRuleTarget / std::max<size_t>(rules1 + rules2, 1);
+			BenchmarkResult results[] = {
+				MeasureBenchmark("FindGrammarType", rules1, 2 * repetitions, [&]() { FindGrammarType(gram1); return rules1; }),
+				MeasureBenchmark("Union", rules1 + rules2, repetitions, [&]() { return RuleCount(CreateGrammarFromUnion(gram1, gram2)); }),
+				MeasureBenchmark("Product", rules1 + rules2, repetitions, [&]() { return RuleCount(CreateGrammarFromProduct(gram1, gram2)); }),
+				MeasureBenchmark("Closure", rules1, 2 * repetitions, [&]() { return RuleCount(CreateGrammarFromClosure(gram1)); })
+			};
+			for (BenchmarkResult* it = std::begin(results); it != std::end(results); it++) {
+				it->type = actualType;
+				PrintBenchmarkResult(std::cout, *it, json);
+			}
+		}
+	}
+
+	return 0;
+}
+
+// Menu/Reading functions
+
+Grammar ReadGrammar() {
+	Grammar newGram;
+	int num = -1;
+	do {
+		std::cout << "How many non-terminals do you want?\n"; std::cin >> num;
+	} while (num < 0);
+
+	for (int i = 0; i < num; i++) {
+		std::string str1;
+		std::cout << "\nRead non-terminal number " << i + 1 << ": "; std::cin >> str1;
+
+		AddNonTerminal(newGram, str1);
+	}
+
+	num = -1;
+	do {
+		std::cout << "\nHow many terminals do you want?\n"; std::cin >> num;
+	} while (num < 0);
+
+	for (int i = 0; i < num; i++) {
+		std::string str1;
+		std::cout << "\nRead terminal number " << i + 1 << ": "; std::cin >> str1;
+
+		AddTerminal(newGram, str1);
+	}
+
+	if (newGram.nonTerminals.size() > 0) {
+		std::cout << "\nRead the number of the non-terminal you want to be the starting point.\n";
+		int count = 1;
+		for (ArenaVector<std::string_view>::const_iterator itNT = newGram.nonTerminals.begin(); itNT != newGram.nonTerminals.end(); itNT++, count++) {
+			std::string_view nT = *itNT;
+			std::cout << count << ". " << nT << '\n';
+		}
+
+		int num = -1;
+		do {
+			std::cin >> num;
+		} while (num < 1 || num > (int)newGram.nonTerminals.size());
+
+		newGram.startingPoint = (Symbol)(num - 1);
+	}
+
+	num = -1;
+	do {
+		std::cout << "\nHow many production rules do you want?\n"; std::cin >> num;
+	} while (num < 0);
+
+	for (int i = 0; i < num; i++) {
+		std::string str1, str2;
+		std::cout << "\n\nRead left-hand side of production rule number " << i + 1 << ": "; std::cin >> str1;
+		std::cout << "\nRead right-hand side of production rule number " << i + 1 << ": "; std::cin >> str2;
+		std::string error;
+		if (!ParseProductionRule(newGram, str1, str2, &error)) {
+			std::cout << "\nThe rule can't be split into the terminals and non-terminals given above (" << error << "), read it again.";
+			i--;
+		}
+	}
+
+	return newGram;
+}
+
+bool RunMenu()
+{
+	int caseNum = 0; const Grammar* selectedGram = &gram1;
+	do {
+		std::cout << "\n\n\nInput your choice.";
+		std::cout << "\n1.Read first grammar.";
+		std::cout << "\n2.Read second grammar.";
+		std::cout << "\n3.Select and print said grammar.";
+		std::cout << "\n4.Select and show the type of said grammar.";
+		std::cout << "\n5.Devise a new grammar under the union of the first and second grammars.";
+		std::cout << "\n6.Devise a new grammar under the product of the first and second grammars.";
+		std::cout << "\n7.Select and devise a new grammar under the Kleene Closure of selected grammar.";
+		std::cout << "\n8.Load first grammar from a file.";
+		std::cout << "\n9.Load second grammar from a file.";
+		std::cout << "\n10.Select and check whether a word belongs to the language of said grammar.";
+		std::cout << "\n11.Select and devise the minimal right-linear grammar of said grammar.";
+		std::cout << "\n12.Select and simplify said grammar.";
+		std::cout << "\n13.Select and analyze the language of said grammar.";
+		std::cout << "\n14.Check whether the first and second grammars have the same language.";
+		std::cout << "\n15.Devise a new grammar under the intersection of the first and second grammars.";
+		std::cout << "\n16.Devise a new grammar under the difference of the first and second grammars.";
+		std::cout << "\n17.Select and devise a new grammar under the complement of said grammar.";
+		std::cin >> caseNum;
+		system("cls");
+	} while (caseNum < 1 || caseNum > 17);
+
+	if (caseNum == 3 || caseNum == 4 || caseNum == 7 || (caseNum >= 10 && caseNum <= 13) || caseNum == 17) {
+		int gramNum = -1;
+		do {
+			std::cout << "\n\n\nInput your choice.";
+			std::cout << "\n1.Select first grammar.";
+			std::cout << "\n2.Select second grammar.";
+			std::cin >> gramNum;
+			system("cls");
+		} while (gramNum != 1 && gramNum != 2);
+
+		selectedGram = (gramNum == 1) ? &gram1 : &gram2; // the operations only read it, so there's no need for a copy
+	}
+
+	switch (caseNum) {
+		case 1: {
+			gram1 = ReadGrammar();
+			break;
+		}
+		case 2: {
+			gram2 = ReadGrammar();
+			break;
+		}
+		case 3: {
+			PrintGrammar(*selectedGram);
+			break;
+		}
+		case 4: {
+			switch (FindGrammarType(*selectedGram)) {
+				case GrammarType::Type0: {
+					std::cout << "\nSelected grammar is of type 0.";
+					break;
+				}
+				case GrammarType::Type1: {
+					std::cout << "\nSelected grammar is of type 1.";
+					break;
+				}
+				case GrammarType::Type2: {
+					std::cout << "\nSelected grammar is of type 2.";
+					break;
+				}
+				case GrammarType::Type3: {
+					std::cout << "\nSelected grammar is of type 3.";
+					break;
+				}
+			}
+			break;
+		}
+		case 5: {
+			Grammar resultingGrammar = CreateGrammarFromUnion(gram1, gram2);
+			PrintGrammar(resultingGrammar);
+			break;
+		}
+		case 6: {
+			Grammar resultingGrammar = CreateGrammarFromProduct(gram1, gram2);
+			PrintGrammar(resultingGrammar);
+			break;
+		}
+		case 7: {
+			Grammar resultingGrammar = CreateGrammarFromClosure(*selectedGram);
+			PrintGrammar(resultingGrammar);
+			break;
+		}
+		case 8:
+		case 9: {
+			std::string path, error;
+			std::cout << "\nRead the path of the grammar file: "; std::cin >> path;
+
+			Grammar loadedGram;
+			if (LoadGrammarFile(path, loadedGram, error)) {
+				((caseNum == 8) ? gram1 : gram2) = std::move(loadedGram);
+			}
+			else {
+				std::cout << "\nCould not load the grammar: " << error;
+			}
+			break;
+		}
+		case 10: {
+			EarleyGrammar earley;
+			ParseTree tree;
+			std::string word, error;
+			std::vector<Symbol> symbols;
+			const GrammarType type = FindGrammarType(*selectedGram);
+			if (type == GrammarType::Type1 || type == GrammarType::Type0) { // no parser for these, so we look for a derivation
+				std::cout << "\nRead the word (\"|\" being the empty word): "; std::cin >> word;
+				char* words[] = { &word[0] };
+				DeriveWords(*selectedGram, words, 1, true);
+				break;
+			}
+			if (!BuildEarley(*selectedGram, earley, error)) {
+				std::cout << "\nCan't check words of this grammar: " << error;
+				break;
+			}
+
+			std::cout << "\nRead the word (\"|\" being the empty word): "; std::cin >> word;
+			if (!SplitWord(*selectedGram, word, symbols, error)) {
+				std::cout << "\nThe word can't be split into terminals of the grammar (" << error << ").";
+			}
+			else if (ParseEarley(*selectedGram, earley, symbols.data(), symbols.size(), tree)) {
+				std::cout << "\nThe word belongs to the language of the selected grammar: ";
+				PrintParseTree(std::cout, *selectedGram, tree);
+			}
+			else {
+				std::cout << "\nThe word doesn't belong to the language of the selected grammar.";
+			}
+			break;
+		}
+		case 11: {
+			Grammar resultingGrammar;
+			std::string error;
+			if (MinimizeGrammar(*selectedGram, resultingGrammar, error)) {
+				PrintGrammar(resultingGrammar);
+			}
+			else {
+				std::cout << "\nCan't minimize this grammar: " << error;
+			}
+			break;
+		}
+		case 12: {
+			Grammar resultingGrammar = SimplifyGrammar(*selectedGram);
+			PrintGrammar(resultingGrammar);
+			break;
+		}
+		case 13: {
+			LanguageProperties properties;
+			std::string error;
+			if (AnalyzeLanguage(*selectedGram, properties, error)) {
+				std::cout << '\n';
+				PrintLanguageProperties(std::cout, *selectedGram, properties);
+			}
+			else {
+				std::cout << "\nCan't analyze this grammar: " << error;
+			}
+			break;
+		}
+		case 14: {
+			EquivalenceResult result;
+			std::string error;
+			if (!CheckEquivalence(gram1, gram2, result, error)) {
+				std::cout << "\nCan't compare these grammars: " << error;
+			}
+			else if (result.equivalent) {
+				std::cout << "\nThe first and second grammars have the same language.";
+			}
+			else {
+				std::cout << "\nThe languages are different, " << WordText(result.counterexample) << " is only in the language of the "
+						  << (result.inFirst ? "first" : "second") << " grammar.";
+			}
+			break;
+		}
+		case 15:
+		case 16:
+		case 17: {
+			Grammar resultingGrammar;
+			std::string error;
+			bool created = false;
+			if (caseNum == 15) {
+				created = CreateGrammarFromIntersection(gram1, gram2, resultingGrammar, error);
+			}
+			else if (caseNum == 16) {
+				created = CreateGrammarFromDifference(gram1, gram2, resultingGrammar, error);
+			}
+			else {
+				created = CreateGrammarFromComplement(*selectedGram, resultingGrammar, error);
+			}
+
+			if (created) {
+				PrintGrammar(resultingGrammar);
+			}
+			else {
+				std::cout << "\nCan't devise this grammar: " << error;
+			}
+			break;
+		}
+	}
+
+	ReportStats();
+
+	char ans = '\0';
+	do {
+		std::cout << "\n\nDo you wish to keep running this program?"; std::cin >> ans;
+	} while (!strchr("yYnN", ans));
+
+	return (strchr("yY", ans));
+}
+
+int main(int argc, char* argv[]) {
+	// main --stats[=json] ...: anything else, then where the time went, on stderr
+	if (argc >= 2 && (strcmp(argv[1], "--stats") == 0 || strcmp(argv[1], "--stats=json") == 0)) {
+#ifdef NO_INSTRUMENTATION
+		std::cerr << "this build has no stats, it was compiled with NO_INSTRUMENTATION\n";
+#endif
+		stats.json = strcmp(argv[1], "--stats=json") == 0;
+		stats.enabled = true;
+		std::atexit(ReportStats);
+		argv[1] = argv[0];
+		argv++;
+		argc--;
+	}
+
+	if (argc == 4 && (strcmp(argv[1], "--to-binary") == 0 || strcmp(argv[1], "--to-text") == 0)) { // main --to-binary <input> <output>
+		std::string error;
+		if (!ConvertGrammarFile(argv[2], argv[3], strcmp(argv[1], "--to-binary") == 0, error)) {
+			std::cerr << error << '\n';
+			return 1;
+		}
+		return 0;
+	}
+
+	if (argc >= 2 && strcmp(argv[1], "--classify") == 0) {
+		return RunBatch(argc, argv);
+	}
+
+	if (argc >= 3 && (strcmp(argv[1], "--member") == 0 || strcmp(argv[1], "--parse") == 0)) {
+		return RunMembership(argc, argv);
+	}
+
+	if (argc >= 2 && strcmp(argv[1], "--match") == 0) {
+		return RunMatch(argc, argv);
+	}
+
+	if (argc >= 2 && strcmp(argv[1], "--equivalent") == 0) {
+		return RunEquivalence(argc, argv);
+	}
+
+	if (argc >= 2 && (strcmp(argv[1], "--intersect") == 0 || strcmp(argv[1], "--difference") == 0 || strcmp(argv[1], "--complement") == 0)) {
+		return RunRegularOperation(argc, argv);
+	}
+
+	if (argc >= 3 && (strcmp(argv[1], "--minimize") == 0 || strcmp(argv[1], "--simplify") == 0)) {
+		return RunRewrite(argc, argv);
+	}
+
+	if (argc >= 2 && strcmp(argv[1], "--analyze") == 0) {
+		return RunAnalysis(argc, argv);
+	}
+
+	if (argc >= 2 && strcmp(argv[1], "--derive") == 0) {
+		return RunDerivationSearch(argc, argv);
+	}
+
+	if (argc >= 2 && (strcmp(argv[1], "--enumerate") == 0 || strcmp(argv[1], "--sample") == 0)) {
+		return RunEnumeration(argc, argv);
+	}
+
+	if (argc >= 2 && strcmp(argv[1], "--bench") == 0) {
+		return RunBenchmark(argc, argv);
+	}
+
+	if (argc >= 2 && strcmp(argv[1], "--bench-allocations") == 0) {
+		return RunAllocationBenchmark((argc >= 3) ? (size_t)atoll(argv[2]) : 100000);
+	}
+
+#ifdef EXPRESSION_CHECKS
+	if (argc >= 2 && strcmp(argv[1], "--check-expressions") == 0) { // only in a build for testing
+		return RunExpressionCheck((argc >= 3) ? (size_t)atoll(argv[2]) : 20);
+	}
+#endif
+
+	AddNonTerminal(gram1, "A");
+	AddNonTerminal(gram1, "B");
+	AddNonTerminal(gram1, "C");
+	AddNonTerminal(gram1, "D");
+	AddNonTerminal(gram1, "E");
+	AddNonTerminal(gram1, "F");
+	AddNonTerminal(gram1, "S");
+	AddTerminal(gram1, "a");
+	AddTerminal(gram1, "b");
+	AddTerminal(gram1, "c");
+	AddTerminal(gram1, "d");
+	AddTerminal(gram1, "0");
+	AddTerminal(gram1, "1");
+	AddTerminal(gram1, "5");
+	gram1.startingPoint = FindSymbol(gram1, "S");
+	ParseProductionRule(gram1, "S", "aA");
+	ParseProductionRule(gram1, "S", "bB");
+	ParseProductionRule(gram1, "S", "cC");
+	ParseProductionRule(gram1, "S", "dD");
+	ParseProductionRule(gram1, "A", "1");
+	ParseProductionRule(gram1, "B", "5");
+	ParseProductionRule(gram1, "C", "5E");
+	ParseProductionRule(gram1, "C", "1F");
+	ParseProductionRule(gram1, "D", "10");
+	ParseProductionRule(gram1, "E", "1");
+	ParseProductionRule(gram1, "F", "5");
+
+	AddNonTerminal(gram2, "X");
+	AddNonTerminal(gram2, "Y");
+	AddNonTerminal(gram2, "Z");
+	AddNonTerminal(gram2, "W");
+	AddNonTerminal(gram2, "R");
+	AddNonTerminal(gram2, "S");
+	AddTerminal(gram2, "x");
+	AddTerminal(gram2, "y");
+	AddTerminal(gram2, "w");
+	AddTerminal(gram2, "z");
+	AddTerminal(gram2, "0");
+	AddTerminal(gram2, "1");
+	AddTerminal(gram2, "5");
+	gram2.startingPoint = FindSymbol(gram2, "S");
+	ParseProductionRule(gram2, "S", "xX");
+	ParseProductionRule(gram2, "S", "yY");
+	ParseProductionRule(gram2, "S", "zZ");
+	ParseProductionRule(gram2, "S", "wW");
+	ParseProductionRule(gram2, "Y", "1R");
+	ParseProductionRule(gram2, "R", "1");
+	ParseProductionRule(gram2, "X", "1");
+	ParseProductionRule(gram2, "Z", "5");
+	ParseProductionRule(gram2, "W", "10");
+
+	while (RunMenu());
+	return 0;
 }
\ No newline at end of file